@@ -1,10 +0,0 @@
-#pragma once
-
-#include <QPoint>
-#include <QPolygon>
-#include <QColor>
-
-#include "DataTypes.h"
-
-
-std::vector<std::vector<int>> delauney( const std::vector<XYZ>& v );
\ No newline at end of file
@@ -1,9 +0,0 @@
-#include "Json.h"
-
-
-//void go()
-//{
-//   Json a( 5 );
-//   Json b( {{"hey", 5}, {"you", false}} );
-//   Json c( {{"hey", 5}, {"you", {"yesyou", 19}}} );
-//}
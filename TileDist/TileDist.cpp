@@ -1,19 +1,22 @@
 #include "TileDist.h"
 #include "Util.h"
 #include "Delauney.h"
+#include "PeriodicTriangulation.h"
+#include "SimulationRunner.h"
+#include "DualExport.h"
+#include "Checkpoint.h"
+#include "Profiler.h"
 
 #include <QPainter>
 #include <QLabel>
 #include <QMouseEvent>
 #include <QShortCut>
-#include <QJsonObject>
-#include <QJsonArray>
-#include <QJsonDocument>
+#include <QSignalBlocker>
+#include <QStringList>
 
+#include <algorithm>
 #include <vector>
 #include <functional>
-#include <unordered_set>
-#include <unordered_map>
 
 namespace
 {
@@ -35,304 +38,137 @@ namespace
 }
 
 
-class Vertex
-{
-public:
-   int _Index;
-   int _Color;
-   XYZ _Pos;
-};
-
-class Sector
-{
-public:
-   bool operator==( const Sector& rhs ) const { return x == rhs.x && y == rhs.y; }
-   Sector operator-() const { return {-x, -y}; }
-
-public:
-   int x, y;
-};
-
-class IGraphShape
-{
-public:
-   virtual XYZ pos( const XYZ& position, const Sector& sector ) const = 0;
-};
-
-class VertexPtr
-{
-public:
-   VertexPtr( const Vertex* vertex, const Sector& sector, const IGraphShape* graphShape )
-      : _Vertex( vertex ), _Sector( sector ), _GraphShape( graphShape )
-   {
-   }
-   VertexPtr() {}
-
-   bool operator==( const VertexPtr& rhs ) const { return _Vertex == rhs._Vertex && _Sector == rhs._Sector; }
-   operator bool() const { return !isNull(); }
-   bool isNull() const { return _Vertex == nullptr; }
-   int color() const { return _Vertex->_Color; }
-   XYZ pos() const { return _GraphShape->pos( _Vertex->_Pos, _Sector ); }
-   int rawIndex() const { return _Vertex->_Index; }
-
-public:
-   const IGraphShape* _GraphShape = nullptr;
-   const Vertex* _Vertex = nullptr;
-   Sector _Sector;
-};
-
-class Simulation : public IGraphShape
+class Drawing : public QWidget
 {
 public:
-   Simulation()
-   {
-      double scale = 2.4;
-      _U = XYZ( 1, 0, 0 ) * scale;
-      _V = XYZ( .5, sqrt(.75), 0 ) * scale;
-      _InvUV = Matrix4x4( XYZW( _U.x, _U.y, 0, 0 ), XYZW( _V.x, _V.y, 0, 0 ), XYZW( 0, 0, 1, 0 ), XYZW( 0, 0, 0, 1 ) ).inverted();
-   }
-
-   XYZ pos( const Sector& sector ) const { return _U * sector.x + _V * sector.y; }
-   XYZ pos( const XYZ& position, const Sector& sector ) const override { return position + pos( sector ); }
-   std::vector<Sector> sectors() const
-   {
-      std::vector<Sector> ret;
-      for ( int y = -1; y <= 1; y++ )
-         for ( int x = -1; x <= 1; x++ )
-            ret.push_back( { x, y } );
-      return ret;
-   }
-   std::vector<VertexPtr> vertices() const
-   {
-      std::vector<VertexPtr> ret;
-      for ( const Sector& sector : sectors() )
-      {
-         for ( const Vertex& a : _Vertices )
-         {
-            ret.push_back( VertexPtr( &a, sector, this ) );
-         }
-      }
-      return ret;
-   }
-   std::vector<VertexPtr> rawVertices() const
-   {
-      std::vector<VertexPtr> ret;
-      Sector sector = { 0, 0 };
-      for ( const Vertex& a : _Vertices )
-      {
-         ret.push_back( VertexPtr( &a, sector, this ) );
-      }
-      return ret;
-   }
-   VertexPtr vertexAt( const XYZ& pos, double maxDist ) const
-   {
-      VertexPtr ret;
-      double bestDist2 = maxDist * maxDist;
-      for ( const VertexPtr& a : vertices() )
-      {
-         double dist2 = a.pos().dist2( pos );
-         if ( dist2 >= bestDist2 )
-            continue;
-         bestDist2 = dist2;
-         ret = a;
-      }
-      return ret;
-   }
-   Vertex* mutableOf( const Vertex* vertex ) const { return const_cast<Vertex*>( vertex ); }
-   void setPos( const VertexPtr& a, const XYZ& pos )
-   {
-      mutableOf( a._Vertex )->_Pos = normalizedPos( pos );
-   }
-   void setColor( const VertexPtr& a, int color )
-   {
-      mutableOf( a._Vertex )->_Color = color;
-   }
-   Sector sectorAt( const XYZ& p ) const
-   {
-      XYZW uv = _InvUV * p;
-      return Sector{ (int)floor( uv.x ), (int)floor( uv.y ) };
-   }
-   XYZ normalizedPos( const XYZ& p ) const
-   {
-      return p - pos( sectorAt( p ) );
-   }
-   void step()
-   {
-      constexpr double MAX_VEL = .1;
-
-      std::vector<XYZ> vel( _Vertices.size() );
-
-      for ( const VertexPtr& a : rawVertices() )
-      {
-         XYZ posA = a.pos();
-         for ( const VertexPtr& b : vertices() )
-         {
-            if ( a == b )
-               continue;
-            XYZ posB = b.pos();
-
-            double minDist = a.color() == b.color() ? _MinDistanceAllowed_SameColor : _MinDistanceAllowed;
-
-            double dist2 = posA.dist2( posB );
-            if ( dist2 >= minDist*minDist ) 
-               continue;
-            double dist = sqrt( dist2 );
-            double distError = minDist - dist;
-
-            vel[a.rawIndex()] += ( posA - posB ).normalized() * distError * _Tension;
-         }
-      }
-
-      for ( const VertexPtr& a : rawVertices() )
-      {
-         if ( vel[a.rawIndex()].len() > .1 )
-            vel[a.rawIndex()] = vel[a.rawIndex()].normalized() * MAX_VEL;
-      }
-
-      for ( const VertexPtr& a : rawVertices() )
-      {
-         if ( a._Vertex != _ClickedVertex._Vertex )
-            setPos( a, a.pos() + vel[a.rawIndex()] );
-      }
-   }
-
-   void step( int numSteps )
-   {
-      for ( int i = 0; i < numSteps; i++ )
-         step();
-   }
-
-   void addVertex( const XYZ& pos, int color )
-   {
-      Vertex a { (int) _Vertices.size(), color, pos };
-      _Vertices.push_back( a );
-   }
-
-   void deleteVertex( const VertexPtr& a )
-   {  
-      int index = a.rawIndex();
-      if ( index < 0 || index >= (int) _Vertices.size() )
-         return;
-
-      _Vertices.erase( _Vertices.begin() + index );
-
-      // renumber
-      for ( int i = index; i < (int) _Vertices.size(); i++ )
-         _Vertices[i]._Index = i;
-   }
-
-   std::vector<VertexPtr> verticesInRange( double R ) const
+   Drawing()
    {
-      std::vector<VertexPtr> ret;
-      Sector sector;
-      for ( sector.y = -10; sector.y <= 10; sector.y++ )
-      for ( sector.x = -10; sector.x <= 10; sector.x++ )
-      for ( const Vertex& aa : _Vertices )
-      {
-         VertexPtr a( &aa, sector, this );
-         XYZ pos = a.pos();
-         if ( pos.len2() > R*R )
-            continue;
-         ret.push_back( a );
-      }
-      return ret;
+      setSizePolicy( QSizePolicy::Expanding, QSizePolicy::Expanding );
+      // every pixel comes from the back buffer
+      setAttribute( Qt::WA_OpaquePaintEvent );
    }
 
-public:
-   std::vector<Vertex> _Vertices;
-   double _MinDistanceAllowed = .75;
-   double _MinDistanceAllowed_SameColor = 2.;
-   XYZ _U;
-   XYZ _V;
-   Matrix4x4 _InvUV;
-   double _Tension = 0;
-
-public:
-   VertexPtr _ClickedVertex;
-};
-
-class Drawing : public QWidget
-{
-public:
-   Drawing()
+   // update() requests pile up until the next paint event, so any number of drags and new snapshots
+   // between two frames cost one render
+   void paintEvent( QPaintEvent* event ) override
    {
-      _Layout = new QVBoxLayout( this );
+      constexpr double FRAME_TIME_WEIGHT = .1;
 
-      _Label = new QLabel;
-      _Label->setSizePolicy( QSizePolicy::Expanding, QSizePolicy::Expanding );
+      Profiler::Clock::time_point now = Profiler::Clock::now();
+      double frameMs = std::chrono::duration<double, std::milli>( now - _LastPaint ).count();
+      _FrameMs += FRAME_TIME_WEIGHT * ( frameMs - _FrameMs );
+      _LastPaint = now;
 
+      ScopedTimer timer( "paint" );
+      if ( _BackBuffer.size() != size() )
+         _BackBuffer = QImage( size(), QImage::Format_RGB32 );
+      updateBitmap();
+      QPainter painter( this );
       {
-         _LabelContainer = new QWidget;
-         _LabelContainer->setContentsMargins( 0, 0, 0, 0 );
-         QLayout* labelContainerLayout = new QVBoxLayout;
-         labelContainerLayout->setMargin( 0 );
-         _LabelContainer->setLayout( labelContainerLayout );
-         _LabelContainer->layout()->addWidget( _Label );
-         _LabelContainer->setSizePolicy( QSizePolicy::Ignored, QSizePolicy::Ignored );
+         ScopedTimer blitTimer( "blit" );
+         painter.drawImage( 0, 0, _BackBuffer );
       }
-
-      _Layout->addWidget( _LabelContainer );
-      _Layout->setMargin( 0 );
+      if ( _ShowTimings )
+         drawTimings( painter );
    }
 
-   void resizeEvent( QResizeEvent* event ) override
-   {
-      updateBitmap();
+   // ms per call of every timed phase, top left on top of the drawing
+   void drawTimings( QPainter& painter )
+   {
+      QStringList lines;
+      lines << QString( "%1 fps" ).arg( _FrameMs > 0 ? 1000 / _FrameMs : 0., 0, 'f', 0 );
+      lines << QString( "%1 steps/s" ).arg( _Runner->latestSnapshot()._StepsPerSecond, 0, 'f', 0 );
+      for ( const PhaseStats& phase : Profiler::instance().phases() )
+         lines << QString( "%1 %2 ms" ).arg( QString( phase._Name ), -18 ).arg( phase._AverageMs, 8, 'f', 3 );
+      QString text = lines.join( "\n" );
+
+      painter.setFont( QFont( "Consolas", 9 ) );
+      QRectF rect = painter.boundingRect( QRectF( 8, 8, width(), height() ), Qt::AlignLeft | Qt::AlignTop, text );
+      painter.fillRect( rect.adjusted( -4, -4, 4, 4 ), QColor( 0, 0, 0, 160 ) );
+      painter.setPen( QColor( 255, 255, 255 ) );
+      painter.drawText( rect, Qt::AlignLeft | Qt::AlignTop, text );
    }
 
    QPointF toBitmap( const XYZ& pt ) const
    {
-      return ::toPointF( (_ModelToBitmap * pt).toXYZ() );
+      return ::toPointF( _ModelToBitmap * pt );
    }
    XYZ toModel( const QPointF& pt ) const
    {
-      return (_ModelToBitmap.inverted() * XYZ( pt.x(), pt.y(), 0 )).toXYZ();
+      return _BitmapToModel * XYZ( pt.x(), pt.y(), 0 );
    }
    double toModel( double dist ) const
    {
-      return (_ModelToBitmap.inverted() * XYZ( dist, 0, 0 )).x - (_ModelToBitmap.inverted() * XYZ( 0, 0, 0 )).x;
+      return _BitmapToModel.linear( XYZ( dist, 0, 0 ) ).x;
    }
 
    void updateBitmap()
    {
-      _ModelToBitmap = Matrix4x4::translation( XYZ( width()/2, height()/2, 0 ) ) * Matrix4x4::scale( XYZ( 100, 100, 1 ) ) * Matrix4x4::scale( XYZ( 1, -1, 1 ) );
-      _ModelToBitmap = _ModelToBitmap * Matrix4x4::translation( (_Simulation->_U + _Simulation->_V) * -.5 );
+      const SimulationSnapshot& snapshot = _Runner->latestSnapshot();
+
+      _ModelToBitmap = Affine2D::translation( XYZ( width()/2, height()/2, 0 ) ) * Affine2D::scale( 100, 100 ) * Affine2D::scale( 1, -1 );
+      _ModelToBitmap = _ModelToBitmap * Affine2D::translation( (snapshot._U + snapshot._V) * -.5 );
+      _BitmapToModel = _ModelToBitmap.inverted();
+
+      auto toBitmap = [&]( const XYZ& pt ) { return toPointF( _ModelToBitmap * pt ); };
 
-      auto toBitmap = [&]( const XYZ& pt ) { return toPointF( (_ModelToBitmap * pt).toXYZ() ); };
+      // the mapping is affine, so every image is its vertex's bitmap position plus its sector's bitmap offset
+      QPointF origin = toBitmap( XYZ( 0, 0, 0 ) );
+      QPointF bitmapU = toBitmap( snapshot._U ) - origin;
+      QPointF bitmapV = toBitmap( snapshot._V ) - origin;
+      auto toBitmapOffset = [&]( const Sector& sector ) { return bitmapU * sector.x + bitmapV * sector.y; };
+      // every copy of the cell the view shows; triangles reach up to |U| + |V| beyond the cell they are stored for
+      XYZ viewCenter = toModel( QPointF( width() / 2., height() / 2. ) );
+      double viewRadius = toModel( hypot( width(), height() ) / 2 + 30 ) + snapshot._U.len() + snapshot._V.len();
+      std::vector<Sector> sectors = snapshot.sectorsInRange( viewCenter, viewRadius );
+      _SectorOffsets.resize( sectors.size() );
+      for ( int s = 0; s < (int) sectors.size(); s++ )
+         _SectorOffsets[s] = toBitmapOffset( sectors[s] );
+      _BitmapPos.resize( snapshot._Vertices.size() );
+      for ( int i = 0; i < (int) snapshot._Vertices.size(); i++ )
+         _BitmapPos[i] = toBitmap( snapshot._Vertices[i]._Pos );
 
-      QImage img( size(), QImage::Format_RGB32 );
-      img.fill( QColor( 120,120,120 ) );
+      _BackBuffer.fill( QColor( 120,120,120 ) );
 
 
       {
-         QPainter painter( &img );
+         QPainter painter( &_BackBuffer );
          painter.setRenderHint( QPainter::Antialiasing );
+         ScopedTimer timer( "drawTriangulation" );
 
          // draw delauney
          if ( _ShowTriangulation )
          {
             painter.setPen( QPen( QColor( 0, 0, 0, 64 ), 1 ) );
 
-            std::vector<VertexPtr> vertices = _Simulation->vertices();
-            std::vector<XYZ> v;
-            for ( const VertexPtr& a : vertices )
-               v.push_back( a.pos() );
-            auto triangulation = delauney( v );
-            for ( const auto& tri : triangulation )
+            _Triangulation.update( snapshot );
+            if ( _Triangulation.topologyChanged() )
+               updateEdges();
+            const std::vector<PeriodicTriangle>& triangulation = _Triangulation.triangles();
+            _Lines.clear();
+            _Lines.reserve( _Edges.size() * sectors.size() );
+            for ( const QPointF& sectorOffset : _SectorOffsets )
             {
-               painter.drawLine( toBitmap( vertices[tri[0]].pos() ), toBitmap( vertices[tri[1]].pos() ) );
-               painter.drawLine( toBitmap( vertices[tri[1]].pos() ), toBitmap( vertices[tri[2]].pos() ) );
-               painter.drawLine( toBitmap( vertices[tri[2]].pos() ), toBitmap( vertices[tri[0]].pos() ) );
+               for ( int halfEdge : _Edges )
+               {
+                  const PeriodicTriangle& tri = triangulation[halfEdge / 3];
+                  int k = halfEdge % 3;
+                  int l = ( k + 1 ) % 3;
+                  _Lines.push_back( QLineF( _BitmapPos[tri._Index[k]] + toBitmapOffset( tri._Sector[k] ) + sectorOffset,
+                                            _BitmapPos[tri._Index[l]] + toBitmapOffset( tri._Sector[l] ) + sectorOffset ) );
+               }
             }
+            painter.drawLines( _Lines.data(), (int) _Lines.size() );
          }
 
          // draw _U, _V
+         timer.next( "drawLattice" );
          painter.setPen( QPen( QColor( 128, 0, 0, 64 ), 5 ) );
          {
-            painter.drawLine( toBitmap( XYZ(0,0,0) ), toBitmap( _Simulation->_U ) );
-            painter.drawLine( toBitmap( XYZ(0,0,0) ), toBitmap( _Simulation->_V ) );
-            painter.drawLine( toBitmap( _Simulation->_U + _Simulation->_V ), toBitmap( _Simulation->_U ) );
-            painter.drawLine( toBitmap( _Simulation->_U + _Simulation->_V ), toBitmap( _Simulation->_V ) );
+            painter.drawLine( toBitmap( XYZ(0,0,0) ), toBitmap( snapshot._U ) );
+            painter.drawLine( toBitmap( XYZ(0,0,0) ), toBitmap( snapshot._V ) );
+            painter.drawLine( toBitmap( snapshot._U + snapshot._V ), toBitmap( snapshot._U ) );
+            painter.drawLine( toBitmap( snapshot._U + snapshot._V ), toBitmap( snapshot._V ) );
          }
 
          //// draw vertices
@@ -340,46 +176,113 @@ public:
          //for ( int sectorY = -1; sectorY <= 1; sectorY++ )
          //{
          //   painter.setPen( QPen( QColor( 0, 0, 0 ), 1 ) );
-         //   for ( const Vertex& a : _Simulation->_Vertices )
+         //   for ( const Vertex& a : snapshot._Vertices )
          //   {
          //      painter.setBrush( tileColor( a._Color ) );
-         //      XYZ sectorOffset = _Simulation->_U * sectorX + _Simulation->_V * sectorY;
+         //      XYZ sectorOffset = snapshot._U * sectorX + snapshot._V * sectorY;
          //      XYZ pos = a._Pos + sectorOffset;
          //      painter.drawEllipse( toBitmap( pos ), 4, 4 );
          //   }
          //}
 
-         // draw vertices
-         painter.setFont( QFont( "Arial", 10 ) );
-
-         painter.setPen( QPen( QColor( 0, 0, 0 ), 1 ) );
-         for ( const VertexPtr& a : _Simulation->vertices() )
+         // draw vertices, one batch of sprites per colour
+         timer.next( "drawVertices" );
+         for ( std::vector<QPainter::PixmapFragment>& fragments : _DotFragments )
+            fragments.clear();
+         for ( std::vector<QPainter::PixmapFragment>& fragments : _LabelFragments )
+            fragments.clear();
+         for ( const QPointF& sectorOffset : _SectorOffsets )
          {
-            painter.setBrush( tileColor( a.color() ) );
-            XYZ pos = a.pos();
-            painter.drawEllipse( toBitmap( pos ), 4, 4 );
-
-            if ( _ShowColorNumber )
+            for ( const Vertex& a : snapshot._Vertices )
             {
-               drawTextCentered( painter, toBitmap( pos ) + QPointF( 0, -11 ), std::to_string( a.color() ) );
+               if ( a._Color >= (int) _DotFragments.size() )
+               {
+                  _DotFragments.resize( a._Color + 1 );
+                  _LabelFragments.resize( a._Color + 1 );
+               }
+               QPointF pos = _BitmapPos[a._Index] + sectorOffset;
+               _DotFragments[a._Color].push_back( QPainter::PixmapFragment::create( pos, dotSprite( a._Color ).rect() ) );
+               if ( _ShowColorNumber )
+                  _LabelFragments[a._Color].push_back( QPainter::PixmapFragment::create( pos + QPointF( 0, -11 ), labelSprite( a._Color ).rect() ) );
             }
+         }
+         for ( int color = 0; color < (int) _DotFragments.size(); color++ )
+         {
+            if ( !_DotFragments[color].empty() )
+               painter.drawPixmapFragments( _DotFragments[color].data(), (int) _DotFragments[color].size(), dotSprite( color ) );
+            if ( !_LabelFragments[color].empty() )
+               painter.drawPixmapFragments( _LabelFragments[color].data(), (int) _LabelFragments[color].size(), labelSprite( color ) );
+         }
+      }
+   }
 
-            //if ( a == _Simulation->_ClickedVertex )
-            //   painter.drawEllipse( toBitmap( pos ), 6, 6 );
+   // one half-edge of every edge of the triangulation. Half-edge ids survive vertices wrapping around,
+   // only flips and rebuilds change them.
+   void updateEdges()
+   {
+      const std::vector<PeriodicTriangle>& triangulation = _Triangulation.triangles();
+      _Edges.clear();
+      for ( int t = 0; t < (int) triangulation.size(); t++ )
+      {
+         const PeriodicTriangle& tri = triangulation[t];
+         for ( int k = 0; k < 3; k++ )
+         {
+            int l = ( k + 1 ) % 3;
+            // the twin runs from l to k with the opposite sector offset
+            Sector offset = tri._Sector[l] - tri._Sector[k];
+            int a = tri._Index[k];
+            int b = tri._Index[l];
+            if ( a < b || ( a == b && ( offset.y > 0 || ( offset.y == 0 && offset.x > 0 ) ) ) )
+               _Edges.push_back( 3 * t + k );
          }
       }
-      _Label->setPixmap( QPixmap::fromImage( img ) );
+   }
+
+   // pre-rendered vertex dot for each colour
+   const QPixmap& dotSprite( int color )
+   {
+      if ( color >= (int) _DotSprites.size() )
+         _DotSprites.resize( color + 1 );
+      QPixmap& sprite = _DotSprites[color];
+      if ( sprite.isNull() )
+      {
+         sprite = QPixmap( 12, 12 );
+         sprite.fill( Qt::transparent );
+         QPainter painter( &sprite );
+         painter.setRenderHint( QPainter::Antialiasing );
+         painter.setPen( QPen( QColor( 0, 0, 0 ), 1 ) );
+         painter.setBrush( tileColor( color ) );
+         painter.drawEllipse( QPointF( 6, 6 ), 4, 4 );
+      }
+      return sprite;
+   }
+
+   // pre-rendered colour number for each colour
+   const QPixmap& labelSprite( int color )
+   {
+      if ( color >= (int) _LabelSprites.size() )
+         _LabelSprites.resize( color + 1 );
+      QPixmap& sprite = _LabelSprites[color];
+      if ( sprite.isNull() )
+      {
+         QFont font( "Arial", 10 );
+         std::string str = std::to_string( color );
+         QRect bounds = QFontMetrics( font ).boundingRect( QString::fromStdString( str ) );
+         sprite = QPixmap( bounds.width() + 4, bounds.height() + 4 );
+         sprite.fill( Qt::transparent );
+         QPainter painter( &sprite );
+         painter.setRenderHint( QPainter::Antialiasing );
+         painter.setFont( font );
+         painter.setPen( QPen( QColor( 0, 0, 0 ), 1 ) );
+         drawTextCentered( painter, QRectF( sprite.rect() ).center(), str );
+      }
+      return sprite;
    }
 
    void mousePressEvent( QMouseEvent* event ) override { _OnLeftPressFunc( toModel( event->pos() ) ); }
    void mouseReleaseEvent( QMouseEvent* event ) override { _OnLeftReleaseFunc( toModel( event->pos() ) ); }
    void mouseMoveEvent( QMouseEvent* event ) override { _OnMouseMoveFunc( toModel( event->pos() ) ); }
 
-public:
-   QVBoxLayout* _Layout;
-   QLabel* _Label;
-   QWidget* _LabelContainer;
-
 public:
    std::function<void(XYZ)> _OnLeftPressFunc;
    std::function<void(XYZ)> _OnLeftReleaseFunc;
@@ -388,10 +291,30 @@ public:
 public:
    bool _ShowTriangulation;
    bool _ShowColorNumber;
+   bool _ShowTimings = false;
 
 public:
-   Matrix4x4 _ModelToBitmap;
-   const Simulation* _Simulation;
+   Affine2D _ModelToBitmap;
+   // inverse of _ModelToBitmap, for every mouse event
+   Affine2D _BitmapToModel;
+   SimulationRunner* _Runner;
+   // kept between frames, the vertices barely move from one snapshot to the next
+   PeriodicTriangulation _Triangulation;
+
+private:
+   // rendering caches, kept between frames so they keep their allocations
+   QImage _BackBuffer;
+   Profiler::Clock::time_point _LastPaint;
+   // recent average time between two paints
+   double _FrameMs = 0;
+   std::vector<int> _Edges;
+   std::vector<QPointF> _BitmapPos;
+   std::vector<QPointF> _SectorOffsets;
+   std::vector<QLineF> _Lines;
+   std::vector<QPixmap> _DotSprites;
+   std::vector<QPixmap> _LabelSprites;
+   std::vector<std::vector<QPainter::PixmapFragment>> _DotFragments;
+   std::vector<std::vector<QPainter::PixmapFragment>> _LabelFragments;
 };
 
 
@@ -401,67 +324,113 @@ public:
 TileDist::TileDist( QWidget* parent )
    : QWidget( parent )
 {
-   _Simulation.reset( new Simulation );   
-   _Simulation->addVertex( XYZ( 0, 0, 0 ), 0 );
-   _Simulation->addVertex( XYZ( 1, 0, 0 ), 1 );
-   _Simulation->addVertex( XYZ( 2, 0.1, 0 ), 2 );
-   _Simulation->addVertex( XYZ( 2.5, 0, 0 ), 3 );
-   _Simulation->addVertex( XYZ( 1, 1, 0 ), 4 );
-   _Simulation->addVertex( XYZ( 2, 1, 0 ), 5 );
-   _Simulation->addVertex( XYZ( 3, 1.1, 0 ), 6 );
-   _Simulation->addVertex( XYZ( 2.1, 2, 0 ), 7 );
+   std::unique_ptr<Simulation> simulation( new Simulation );
+   simulation->setNumThreads( 0 );
+   simulation->addVertex( XYZ( 0, 0, 0 ), 0 );
+   simulation->addVertex( XYZ( 1, 0, 0 ), 1 );
+   simulation->addVertex( XYZ( 2, 0.1, 0 ), 2 );
+   simulation->addVertex( XYZ( 2.5, 0, 0 ), 3 );
+   simulation->addVertex( XYZ( 1, 1, 0 ), 4 );
+   simulation->addVertex( XYZ( 2, 1, 0 ), 5 );
+   simulation->addVertex( XYZ( 3, 1.1, 0 ), 6 );
+   simulation->addVertex( XYZ( 2.1, 2, 0 ), 7 );
 
    ui.setupUi( this );
    ui.horizontalLayout->removeWidget( ui.drawingPlaceholder );
 
+   ui.uxLineEdit->setText( QString::number( simulation->_U.x ) );
+   ui.uyLineEdit->setText( QString::number( simulation->_U.y ) );
+   ui.vxLineEdit->setText( QString::number( simulation->_V.x ) );
+   ui.vyLineEdit->setText( QString::number( simulation->_V.y ) );
+   ui.minDistDiffLineEdit->setText( QString::number( simulation->_MinDistanceAllowed ) );
+   ui.minDistSameLineEdit->setText( QString::number( simulation->_MinDistanceAllowed_SameColor ) );
+   ui.pairDistLineEdit->setText( QString::fromStdString( simulation->_PairDistances.toString() ) );
+   ui.symmetryLineEdit->setText( QString::fromStdString( simulation->_Symmetry.toString() ) );
+
+   _Runner.reset( new SimulationRunner( std::move( simulation ) ) );
+
    _Drawing = new Drawing();
-   _Drawing->_Simulation = _Simulation.get();
+   _Drawing->_Runner = _Runner.get();
    ui.horizontalLayout->insertWidget( 0, _Drawing );
 
 
    _Drawing->_OnLeftPressFunc = [this]( XYZ clickPos )
    {
-      _Simulation->_ClickedVertex = _Simulation->vertexAt( clickPos, _Drawing->toModel( 30 ) );
+      const SimulationSnapshot& snapshot = _Runner->latestSnapshot();
+      VertexPtr a = snapshot.vertexAt( clickPos, _Drawing->toModel( 30 ) );
+      ImageSource source = a ? snapshot._Sources[a.rawIndex()] : ImageSource{ -1, 0 };
+      _Runner->post( [source]( Simulation& simulation )
+      {
+         simulation._ClickedVertex = simulation.rawVertex( source._Vertex );
+         simulation._ClickedElement = source._Element < simulation._Symmetry.order() ? source._Element : 0;
+      } );
       //redraw();
       _Drawing->_OnMouseMoveFunc( clickPos );
    };
    _Drawing->_OnLeftReleaseFunc = [this]( XYZ clickPos )
    {
-      _Simulation->_ClickedVertex = VertexPtr();
+      _Runner->post( []( Simulation& simulation ) { simulation._ClickedVertex = VertexPtr(); } );
       redraw();
    };
    _Drawing->_OnMouseMoveFunc = [this]( XYZ clickPos )
    {
-      if ( _Simulation->_ClickedVertex )
-         _Simulation->setPos( _Simulation->_ClickedVertex, clickPos );
+      _Runner->post( [clickPos]( Simulation& simulation )
+      {
+         // the clicked image follows the mouse, the stored vertex goes where it has to for that
+         if ( simulation._ClickedVertex )
+         {
+            XYZ pos = simulation._Symmetry.rotation( simulation._ClickedElement ).inverted() * clickPos;
+            simulation.setPos( simulation._ClickedVertex, simulation.offCentrePos( pos, simulation._ClickedVertex.color() ) );
+         }
+      } );
       redraw();
    };
 
-   connect( &_PlayTimer, &QTimer::timeout, [this] { _Simulation->step( 50 ); redraw(); } );
+   // the simulation runs on its own thread; the GUI only picks up what it has published
+   connect( &_RedrawTimer, &QTimer::timeout, [this] { if ( _Runner->hasNewSnapshot() ) redraw(); } );
 
    connect( ui.playButton, &QPushButton::clicked, [this]() 
    { 
-      if ( _PlayTimer.isActive() )
-         _PlayTimer.stop();
-      else
-         _PlayTimer.start();   
+      _Runner->setRunning( !_Runner->isRunning() );
 
-      ui.playButton->setText( _PlayTimer.isActive() ? "||" : ">" );
+      ui.playButton->setText( _Runner->isRunning() ? "||" : ">" );
    } );
    connect( ui.exportButton, &QPushButton::clicked, [this]() 
    { 
       exportAsDual();
    } );
+   connect( ui.saveCheckpointButton, &QPushButton::clicked, [this]() { saveCheckpoint(); } );
+   connect( ui.loadCheckpointButton, &QPushButton::clicked, [this]() { loadCheckpoint(); } );
+
+   // long relaxations survive closing the app; nothing is written while the simulation stands still
+   _SavedStepCount = _Runner->latestSnapshot()._StepCount;
+   connect( &_AutosaveTimer, &QTimer::timeout, [this]()
+   {
+      if ( _Autosave && _Runner->latestSnapshot()._StepCount != _SavedStepCount )
+         saveCheckpoint();
+   } );
+   _AutosaveTimer.setInterval( 5000 );
+   _AutosaveTimer.start();
 
    connect( ui.tensionSlider, &QSlider::valueChanged, [this]( int value ) {
       double t = (double) value / ui.tensionSlider->maximum();
       //ui.outerRadiusEdit->setText( QString("%1").arg( r ) );
-      _Simulation->_Tension = interpolateExp( t, .001, 1. );
+      double tension = interpolateExp( t, .001, 1. );
+      _Runner->post( [tension]( Simulation& simulation ) { simulation._Tension = tension; } );
       //updateModelFromUI();
       redraw();
    } );
    ui.tensionSlider->valueChanged( ui.tensionSlider->value() );
 
+   // in the order of Simulation::Method
+   connect( ui.methodComboBox, QOverload<int>::of( &QComboBox::currentIndexChanged ), [this]( int index ) {
+      Simulation::Method method = (Simulation::Method) index;
+      _Runner->post( [method]( Simulation& simulation ) { simulation._Method = method; } );
+      // the minimisers don't use the tension
+      ui.tensionSlider->setEnabled( method == Simulation::CLAMPED );
+      redraw();
+   } );
+
    connect( ui.showTriangulationCheckBox, &QCheckBox::toggled, [this]() {
       _Drawing->_ShowTriangulation = ui.showTriangulationCheckBox->isChecked();
       redraw();
@@ -473,47 +442,114 @@ TileDist::TileDist( QWidget* parent )
       redraw();
    } );
    ui.showColorNumberCheckBox->toggled( ui.showTriangulationCheckBox->isChecked() );
+
+   connect( ui.showTimingsCheckBox, &QCheckBox::toggled, [this]() {
+      _Drawing->_ShowTimings = ui.showTimingsCheckBox->isChecked();
+      Profiler::instance().setCollecting( _Drawing->_ShowTimings );
+      redraw();
+   } );
+
+   connect( ui.traceButton, &QPushButton::clicked, [this]() { toggleTrace(); } );
    
 
-   connect( ui.uxLineEdit, &QLineEdit::editingFinished, [this]() {
-      _Simulation->_U.x = ui.uxLineEdit->text().toDouble();
+   // a lattice the symmetry doesn't fit is refused, as a symmetry the lattice doesn't fit is; the edits then show
+   // the lattice again, but only the simulation thread knows for certain which symmetry applies
+   auto setUV = [this]( std::function<void( XYZ& u, XYZ& v )> change )
+   {
+      const SimulationSnapshot& snapshot = _Runner->latestSnapshot();
+      XYZ u = snapshot._U;
+      XYZ v = snapshot._V;
+      change( u, v );
+      if ( !snapshot._Symmetry.fits( Lattice2D( u, v ) ) )
+      {
+         qWarning( "the lattice has no %d-fold rotation about the origin, set the symmetry to p1 first", snapshot._Symmetry.order() );
+         ui.uxLineEdit->setText( QString::number( snapshot._U.x ) );
+         ui.uyLineEdit->setText( QString::number( snapshot._U.y ) );
+         ui.vxLineEdit->setText( QString::number( snapshot._V.x ) );
+         ui.vyLineEdit->setText( QString::number( snapshot._V.y ) );
+         return;
+      }
+      _Runner->post( [change]( Simulation& simulation )
+      {
+         XYZ u = simulation._U;
+         XYZ v = simulation._V;
+         change( u, v );
+         std::string error;
+         if ( !simulation.setUV( u, v, error ) )
+            qWarning( "%s", error.c_str() );
+      } );
+   };
+   connect( ui.uxLineEdit, &QLineEdit::editingFinished, [this, setUV]() {
+      double x = ui.uxLineEdit->text().toDouble();
+      setUV( [x]( XYZ& u, XYZ& v ) { u.x = x; } );
       killFocus( ui.uxLineEdit );
       redraw();
    } );
-   connect( ui.uyLineEdit, &QLineEdit::editingFinished, [this]() {
-      _Simulation->_U.y = ui.uyLineEdit->text().toDouble();
+   connect( ui.uyLineEdit, &QLineEdit::editingFinished, [this, setUV]() {
+      double x = ui.uyLineEdit->text().toDouble();
+      setUV( [x]( XYZ& u, XYZ& v ) { u.y = x; } );
       killFocus( ui.uyLineEdit );
       redraw();
    } );
-   connect( ui.vxLineEdit, &QLineEdit::editingFinished, [this]() {
-      _Simulation->_V.x = ui.vxLineEdit->text().toDouble();
+   connect( ui.vxLineEdit, &QLineEdit::editingFinished, [this, setUV]() {
+      double x = ui.vxLineEdit->text().toDouble();
+      setUV( [x]( XYZ& u, XYZ& v ) { v.x = x; } );
       killFocus( ui.vxLineEdit );
       redraw();
    } );
-   connect( ui.vyLineEdit, &QLineEdit::editingFinished, [this]() {
-      _Simulation->_V.y = ui.vyLineEdit->text().toDouble();
+   connect( ui.vyLineEdit, &QLineEdit::editingFinished, [this, setUV]() {
+      double x = ui.vyLineEdit->text().toDouble();
+      setUV( [x]( XYZ& u, XYZ& v ) { v.y = x; } );
       killFocus( ui.vyLineEdit );
       redraw();
    } );
    connect( ui.minDistDiffLineEdit, &QLineEdit::editingFinished, [this]() {
-      _Simulation->_MinDistanceAllowed = ui.minDistDiffLineEdit->text().toDouble();
+      double x = ui.minDistDiffLineEdit->text().toDouble();
+      _Runner->post( [x]( Simulation& simulation ) { simulation._MinDistanceAllowed = x; } );
       killFocus( ui.minDistDiffLineEdit );
       redraw();
    } );
    connect( ui.minDistSameLineEdit, &QLineEdit::editingFinished, [this]() {
-      _Simulation->_MinDistanceAllowed_SameColor = ui.minDistSameLineEdit->text().toDouble();
+      double x = ui.minDistSameLineEdit->text().toDouble();
+      _Runner->post( [x]( Simulation& simulation ) { simulation._MinDistanceAllowed_SameColor = x; } );
       killFocus( ui.minDistSameLineEdit );
       redraw();
    } );
-   ui.uxLineEdit->setText( QString::number( _Simulation->_U.x ) );
-   ui.uyLineEdit->setText( QString::number( _Simulation->_U.y ) );
-   ui.vxLineEdit->setText( QString::number( _Simulation->_V.x ) );
-   ui.vyLineEdit->setText( QString::number( _Simulation->_V.y ) );
-   ui.minDistDiffLineEdit->setText( QString::number( _Simulation->_MinDistanceAllowed ) );
-   ui.minDistSameLineEdit->setText( QString::number( _Simulation->_MinDistanceAllowed_SameColor ) );
-
+   connect( ui.pairDistLineEdit, &QLineEdit::editingFinished, [this]() {
+      PairDistances pairDistances;
+      std::string error;
+      if ( !pairDistances.parse( ui.pairDistLineEdit->text().toStdString(), error ) )
+      {
+         qWarning( "%s", error.c_str() );
+         return;
+      }
+      ui.pairDistLineEdit->setText( QString::fromStdString( pairDistances.toString() ) );
+      _Runner->post( [pairDistances]( Simulation& simulation ) { simulation._PairDistances = pairDistances; } );
+      killFocus( ui.pairDistLineEdit );
+      redraw();
+   } );
+   connect( ui.symmetryLineEdit, &QLineEdit::editingFinished, [this]() {
+      Symmetry symmetry;
+      std::string error;
+      if ( !symmetry.parse( ui.symmetryLineEdit->text().toStdString(), error ) )
+      {
+         qWarning( "%s", error.c_str() );
+         return;
+      }
+      ui.symmetryLineEdit->setText( QString::fromStdString( symmetry.toString() ) );
+      // whether the lattice allows it is only known on the simulation thread
+      _Runner->post( [symmetry]( Simulation& simulation )
+      {
+         std::string error;
+         if ( !simulation.setSymmetry( symmetry, error ) )
+            qWarning( "%s", error.c_str() );
+      } );
+      killFocus( ui.symmetryLineEdit );
+      redraw();
+   } );
 
-   _PlayTimer.setInterval( 16 );
+   _RedrawTimer.setInterval( 16 );
+   _RedrawTimer.start();
    ui.playButton->click();
 
 
@@ -550,9 +586,23 @@ TileDist::TileDist( QWidget* parent )
    QObject::connect( new QShortcut(QKeySequence(Qt::SHIFT + Qt::Key_9), this ), &QShortcut::activated, [this]() { addVertex( 19 ); } );
 }
 
+TileDist::~TileDist()
+{
+}
+
 void TileDist::redraw()
 {
-   _Drawing->updateBitmap();
+   _Drawing->update();
+
+   const SimulationSnapshot& snapshot = _Runner->latestSnapshot();
+   QString status = QString( "%1 steps/s\nmax move %2\nrms move %3\nenergy %4" )
+      .arg( snapshot._StepsPerSecond, 0, 'f', 0 )
+      .arg( snapshot._Stats._MaxDisplacement, 0, 'g', 3 )
+      .arg( snapshot._Stats._RmsDisplacement, 0, 'g', 3 )
+      .arg( snapshot._Stats._Energy, 0, 'g', 3 );
+   if ( snapshot._Settled )
+      status += "\nsettled";
+   ui.statusLabel->setText( status );
 }
 
 XYZ TileDist::mousePos() const
@@ -562,94 +612,118 @@ XYZ TileDist::mousePos() const
 
 void TileDist::addVertex( int color )
 {
-   VertexPtr a = _Simulation->vertexAt( mousePos(), _Drawing->toModel( 30 ) );
-   if ( a )
-   {
-      _Simulation->setColor( a, color );
-   }
-   else
-   {
-      _Simulation->addVertex( mousePos(), color );
-   }
+   XYZ pos = mousePos();
+   const SimulationSnapshot& snapshot = _Runner->latestSnapshot();
+   VertexPtr a = snapshot.vertexAt( pos, _Drawing->toModel( 30 ) );
+   ImageSource source = a ? snapshot._Sources[a.rawIndex()] : ImageSource{ -1, 0 };
+   _Runner->post( [source, pos, color]( Simulation& simulation )
+   {
+      // the image gets the colour, so the stored vertex the one that the image's element turns into it
+      if ( VertexPtr a = simulation.rawVertex( source._Vertex ) )
+         simulation.setColor( a, source._Element < simulation._Symmetry.order() ? simulation._Symmetry.colorPerm( source._Element ).inverted()[color] : color );
+      else
+         simulation.addVertex( pos, color );
+   } );
 }
 
 void TileDist::deleteVertex()
 {
-   VertexPtr a = _Simulation->vertexAt( mousePos(), _Drawing->toModel( 30 ) );
+   const SimulationSnapshot& snapshot = _Runner->latestSnapshot();
+   VertexPtr a = snapshot.vertexAt( mousePos(), _Drawing->toModel( 30 ) );
    if ( !a )
       return;
-   _Simulation->deleteVertex( a );
+   int index = snapshot._Sources[a.rawIndex()]._Vertex;
+   _Runner->post( [index]( Simulation& simulation )
+   {
+      if ( VertexPtr a = simulation.rawVertex( index ) )
+         simulation.deleteVertex( a );
+   } );
+}
+
+void TileDist::exportAsDual()
+{   
+   double R = ui.exportRadiusLineEdit->text().toDouble();
+   const SimulationSnapshot& snapshot = _Runner->latestSnapshot();
+   if ( ui.exportPeriodicCheckBox->isChecked() )
+      ::exportAsPeriodicDual( snapshot, "test.dual", snapshot._Symmetry );
+   else
+      ::exportAsDual( snapshot, R, "test.dual", snapshot._Symmetry );
 }
 
-QJsonArray toJson( const XYZ& p )
+namespace
 {
-   return QJsonArray { p.x, p.y, p.z };
+   const char* CHECKPOINT_FILENAME = "checkpoint.tdck";
+   // open in chrome://tracing or ui.perfetto.dev
+   const char* TRACE_FILENAME = "trace.json";
 }
 
-QJsonArray neighborsToJson( const std::vector<int>& v )
+void TileDist::saveCheckpoint()
 {
-   QJsonArray ret;
-   for ( int x : v )
-      ret.append( QJsonObject { {"index", x}, {"sector", 0} } );
-   return ret;
+   // written on the simulation thread, so the GUI doesn't wait for large states
+   _SavedStepCount = _Runner->latestSnapshot()._StepCount;
+   _Autosave = true;
+   _Runner->postQuery( []( const Simulation& simulation )
+   {
+      std::string error;
+      if ( !::saveCheckpoint( simulation, CHECKPOINT_FILENAME, error ) )
+         qWarning( "%s", error.c_str() );
+   } );
 }
 
-QJsonObject toJson( const std::vector<Vertex>& vertices, const std::vector<std::vector<int>>& neighbors )
+void TileDist::toggleTrace()
 {
-   QJsonArray vertexArray;
-   for ( int i = 0; i < (int) vertices.size(); i++ )
+   if ( !Profiler::instance().isTracing() )
    {
-      const auto& a = vertices[i];
-      vertexArray.append( QJsonObject { {"index", i}, {"color", vertices[i]._Color}, {"pos", toJson( a._Pos ) }, {"neighbors", neighborsToJson( neighbors[i] )} } );
+      Profiler::instance().startTrace();
+      ui.traceButton->setText( "Stop trace" );
+      return;
    }
-
-   return QJsonObject { { "symmetry", QJsonValue() }, { "shape", QJsonObject { { "type", "plane" } } }, { "vertices", vertexArray } };   
+   std::string error;
+   if ( !Profiler::instance().writeTrace( TRACE_FILENAME, error ) )
+      qWarning( "%s", error.c_str() );
+   ui.traceButton->setText( "Start trace" );
 }
 
-void TileDist::exportAsDual()
-{   
-   double R = ui.exportRadiusLineEdit->text().toDouble();
-   std::vector<VertexPtr> vertices = _Simulation->verticesInRange( R + 2 );
-   std::sort( vertices.begin(), vertices.end(), []( const VertexPtr& a, const VertexPtr& b ) { return a.pos().len2() < b.pos().len2(); } );
-   int numValidVertices;
-   for ( numValidVertices = 0; numValidVertices < (int) vertices.size(); numValidVertices++ )
-      if ( vertices[numValidVertices].pos().len2() >= R*R )
-         break;
-   std::vector<std::vector<int>> triangulation;
+void TileDist::loadCheckpoint()
+{
+   std::shared_ptr<Simulation> loaded( new Simulation() );
+   std::string error;
+   if ( !::loadCheckpoint( CHECKPOINT_FILENAME, *loaded, error ) )
    {
-      std::vector<XYZ> v;
-      for ( int i = 0; i < (int) vertices.size(); i++ )
-         v.push_back( vertices[i].pos() );
-      triangulation = delauney( v );
+      qWarning( "%s", error.c_str() );
+      return;
    }
 
-   // construct output graph
-   std::vector<Vertex> v;
-   std::vector<std::vector<int>> neighbors( numValidVertices );
-   {
-      std::vector<std::unordered_set<int>> neighbs( numValidVertices );
-      for ( const std::vector<int>& v : triangulation )
-      {
-         if ( v[0] >= numValidVertices || v[1] >= numValidVertices || v[2] >= numValidVertices ) continue;
-         neighbs[v[0]].insert( v[1] );
-         neighbs[v[0]].insert( v[2] );
-         neighbs[v[1]].insert( v[2] );
-         neighbs[v[1]].insert( v[0] );
-         neighbs[v[2]].insert( v[0] );
-         neighbs[v[2]].insert( v[1] );
-      }
-
-      for ( int i = 0; i < numValidVertices; i++ )
-         v.push_back( Vertex { i, vertices[i].color(), vertices[i].pos() } );
-      for ( int i = 0; i < numValidVertices; i++ )
-         neighbors[i] = std::vector<int>( neighbs[i].begin(), neighbs[i].end() );
+   ui.uxLineEdit->setText( QString::number( loaded->_U.x ) );
+   ui.uyLineEdit->setText( QString::number( loaded->_U.y ) );
+   ui.vxLineEdit->setText( QString::number( loaded->_V.x ) );
+   ui.vyLineEdit->setText( QString::number( loaded->_V.y ) );
+   ui.minDistDiffLineEdit->setText( QString::number( loaded->_MinDistanceAllowed ) );
+   ui.minDistSameLineEdit->setText( QString::number( loaded->_MinDistanceAllowed_SameColor ) );
+   ui.pairDistLineEdit->setText( QString::fromStdString( loaded->_PairDistances.toString() ) );
+   ui.symmetryLineEdit->setText( QString::fromStdString( loaded->_Symmetry.toString() ) );
+   // the slider only approximates the tension, which must not overwrite the loaded one; it has no position for 0
+   if ( loaded->_Tension > 0 )
+   {
+      QSignalBlocker blocker( ui.tensionSlider );
+      double t = std::clamp( log( loaded->_Tension / .001 ) / log( 1. / .001 ), 0., 1. );
+      ui.tensionSlider->setValue( (int) round( t * ui.tensionSlider->maximum() ) );
    }
 
-   // write to file
-   {
-      QString filename = "test.dual";
-      QFile f( filename );
-      f.open( QFile::WriteOnly );
-      f.write( QJsonDocument( toJson( v, neighbors ) ).toJson() );
-   }
-}
+   _Runner->post( [loaded]( Simulation& simulation )
+   {
+      simulation._ClickedVertex = VertexPtr();
+      simulation._Vertices.swap( loaded->_Vertices );
+      // before setUV(), which keeps the vertices off the centres of this symmetry's rotations
+      simulation._Symmetry = loaded->_Symmetry;
+      simulation._ClickedElement = 0;
+      simulation.setUV( loaded->_U, loaded->_V );
+      simulation._MinDistanceAllowed = loaded->_MinDistanceAllowed;
+      simulation._MinDistanceAllowed_SameColor = loaded->_MinDistanceAllowed_SameColor;
+      simulation._PairDistances = loaded->_PairDistances;
+      simulation._Tension = loaded->_Tension;
+   } );
+   // the loaded state is what the autosave continues
+   _SavedStepCount = _Runner->latestSnapshot()._StepCount;
+   _Autosave = true;
+}
\ No newline at end of file
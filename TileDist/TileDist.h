@@ -8,7 +8,7 @@
 #include <QTimer>
 
 class Drawing;
-class Simulation;
+class SimulationRunner;
 
 class TileDist : public QWidget
 {
@@ -16,17 +16,25 @@ class TileDist : public QWidget
 
 public:
    TileDist( QWidget* parent = Q_NULLPTR );
+   ~TileDist();
    void redraw();
    void addVertex( int color );
    XYZ mousePos() const;
    void deleteVertex();
    void exportAsDual();
+   void saveCheckpoint();
+   void loadCheckpoint();
+   void toggleTrace();
 
 private:
    Ui::TileDistClass ui;
 
-   QTimer _PlayTimer;
+   QTimer _RedrawTimer;
+   QTimer _AutosaveTimer;
+   long long _SavedStepCount = 0;
+   // only once the user saved or loaded, so starting the app never overwrites the last session's checkpoint
+   bool _Autosave = false;
 
    Drawing* _Drawing;
-   std::shared_ptr<Simulation> _Simulation;
+   std::unique_ptr<SimulationRunner> _Runner;
 };
@@ -0,0 +1,318 @@
+#include "Simulation.h"
+#include "SimulationRunner.h"
+#include "Delauney.h"
+#include "DualExport.h"
+#include "JsonWriter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+// every allocation of the process goes through here, so a case can report how many it made
+namespace
+{
+   std::atomic<long long> s_NumAllocations { 0 };
+   std::atomic<long long> s_AllocatedBytes { 0 };
+
+   void* countedAlloc( size_t size )
+   {
+      s_NumAllocations.fetch_add( 1, std::memory_order_relaxed );
+      s_AllocatedBytes.fetch_add( (long long) size, std::memory_order_relaxed );
+      if ( void* p = malloc( size ? size : 1 ) )
+         return p;
+      throw std::bad_alloc();
+   }
+}
+
+void* operator new( size_t size ) { return countedAlloc( size ); }
+void* operator new[]( size_t size ) { return countedAlloc( size ); }
+void operator delete( void* p ) noexcept { free( p ); }
+void operator delete[]( void* p ) noexcept { free( p ); }
+void operator delete( void* p, size_t ) noexcept { free( p ); }
+void operator delete[]( void* p, size_t ) noexcept { free( p ); }
+
+namespace
+{
+   typedef std::chrono::steady_clock Clock;
+
+   class Settings
+   {
+   public:
+      std::vector<int> _Sizes = { 100, 1000, 10000, 100000, 1000000 };
+      // each case repeats until it has run this long, and at least _MinIterations times
+      double _MinSeconds = .5;
+      int _MinIterations = 3;
+      int _NumThreads = 0;
+      std::string _Filter;
+      std::string _OutFile = "bench.json";
+   };
+
+   class Result
+   {
+   public:
+      std::string _Name;
+      int _NumVertices = 0;
+      int _Iterations = 0;
+      // per iteration, in seconds
+      double _Mean = 0;
+      double _P50 = 0;
+      double _P90 = 0;
+      double _P99 = 0;
+      double _Max = 0;
+      double _ItemsPerSecond = 0;
+      double _AllocationsPerIteration = 0;
+      double _BytesPerIteration = 0;
+   };
+
+   void printUsage()
+   {
+      printf( "usage: TileDistBench [options]\n"
+              "   --sizes <n,n,...>      vertex counts of the synthetic scenes (default 100,1000,10000,100000,1000000)\n"
+              "   --min-time <s>         time spent on each case (default 0.5)\n"
+              "   --threads <n>          worker threads for stepping, 0 = one per core (default 0)\n"
+              "   --filter <name>        only run cases whose name contains name\n"
+              "   --out <file>           results as JSON (default bench.json)\n" );
+   }
+
+   // random layout with about one vertex per unit area, in 8 colours, on a hexagonal lattice
+   void makeScene( int numVertices, uint64_t seed, Simulation& simulation )
+   {
+      double scale = sqrt( numVertices / sqrt( .75 ) );
+      simulation.setUV( XYZ( 1, 0, 0 ) * scale, XYZ( .5, sqrt( .75 ), 0 ) * scale );
+      simulation._Tension = .05;
+      simulation._Vertices.clear();
+      std::mt19937_64 rng( seed );
+      std::uniform_real_distribution<double> unit( 0, 1 );
+      for ( int i = 0; i < numVertices; i++ )
+         simulation.addVertex( simulation._U * unit( rng ) + simulation._V * unit( rng ), (int) ( rng() % 8 ) );
+   }
+
+   double percentile( const std::vector<double>& sorted, double p )
+   {
+      return sorted[std::min( (int) sorted.size() - 1, (int) ( p * sorted.size() ) )];
+   }
+
+   // times iteration(), which returns how many items it processed, until the time and iteration minimums are met
+   Result measure( const Settings& settings, const std::string& name, int numVertices, std::function<double()> iteration )
+   {
+      Result result;
+      result._Name = name;
+      result._NumVertices = numVertices;
+
+      // one warm-up call, so caches and buffers are in place
+      iteration();
+
+      std::vector<double> times;
+      times.reserve( 1024 );
+      double totalSeconds = 0;
+      double totalItems = 0;
+      long long allocations = 0;
+      long long bytes = 0;
+      while ( totalSeconds < settings._MinSeconds || (int) times.size() < settings._MinIterations )
+      {
+         long long allocationsBefore = s_NumAllocations;
+         long long bytesBefore = s_AllocatedBytes;
+         auto start = Clock::now();
+         totalItems += iteration();
+         double seconds = std::chrono::duration<double>( Clock::now() - start ).count();
+         allocations += s_NumAllocations - allocationsBefore;
+         bytes += s_AllocatedBytes - bytesBefore;
+         totalSeconds += seconds;
+         if ( times.size() == times.capacity() )
+            times.reserve( 2 * times.size() );
+         times.push_back( seconds );
+      }
+
+      std::sort( times.begin(), times.end() );
+      result._Iterations = (int) times.size();
+      result._Mean = totalSeconds / times.size();
+      result._P50 = percentile( times, .5 );
+      result._P90 = percentile( times, .9 );
+      result._P99 = percentile( times, .99 );
+      result._Max = times.back();
+      result._ItemsPerSecond = totalSeconds > 0 ? totalItems / totalSeconds : 0;
+      result._AllocationsPerIteration = (double) allocations / times.size();
+      result._BytesPerIteration = (double) bytes / times.size();
+
+      printf( "%-18s %8d %8d %12.3f %12.3f %12.3f %12.3f %14.4g %12.1f %14.0f\n", name.c_str(), numVertices, result._Iterations,
+              result._P50 * 1e6, result._P90 * 1e6, result._P99 * 1e6, result._Max * 1e6, result._ItemsPerSecond, result._AllocationsPerIteration, result._BytesPerIteration );
+      fflush( stdout );
+      return result;
+   }
+
+   void runCases( const Settings& settings, int numVertices, std::vector<Result>& results )
+   {
+      auto wanted = [&]( const std::string& name ) { return settings._Filter.empty() || name.find( settings._Filter ) != std::string::npos; };
+
+      Simulation simulation;
+      simulation.setNumThreads( settings._NumThreads );
+      makeScene( numVertices, numVertices, simulation );
+      double area = fabs( simulation._U.x * simulation._V.y - simulation._U.y * simulation._V.x );
+
+      if ( wanted( "step" ) )
+      {
+         Simulation stepped;
+         stepped.setNumThreads( settings._NumThreads );
+         makeScene( numVertices, numVertices, stepped );
+         results.push_back( measure( settings, "step", numVertices, [&] { stepped.step(); return (double) numVertices; } ) );
+      }
+
+      if ( wanted( "vertexAt" ) )
+      {
+         SimulationSnapshot snapshot;
+         snapshot._Vertices = simulation._Vertices;
+         snapshot._U = simulation._U;
+         snapshot._V = simulation._V;
+         snapshot.updateIndex();
+         std::mt19937_64 rng( 1 );
+         std::uniform_real_distribution<double> unit( -1, 2 );
+         // a batch of clicks per iteration keeps the clock's own cost out of the latency
+         const int CLICKS = 100;
+         results.push_back( measure( settings, "vertexAt", numVertices, [&]
+         {
+            for ( int k = 0; k < CLICKS; k++ )
+               snapshot.vertexAt( snapshot._U * unit( rng ) + snapshot._V * unit( rng ), .3 );
+            return (double) CLICKS;
+         } ) );
+      }
+
+      if ( wanted( "verticesInRange" ) )
+      {
+         // a disc of four times the domain's area
+         double R = sqrt( 4 * area / PI );
+         results.push_back( measure( settings, "verticesInRange", numVertices, [&] { return (double) simulation.verticesInRange( R ).size(); } ) );
+      }
+
+      if ( wanted( "delauney" ) )
+      {
+         std::vector<XYZ> positions;
+         for ( const Vertex& a : simulation._Vertices )
+            positions.push_back( a._Pos );
+         results.push_back( measure( settings, "delauney", numVertices, [&] { delauney( positions ); return (double) numVertices; } ) );
+      }
+
+      if ( wanted( "periodicDelauney" ) )
+         results.push_back( measure( settings, "periodicDelauney", numVertices, [&] { periodicDelauney( simulation ); return (double) numVertices; } ) );
+
+      if ( wanted( "exportAsDual" ) )
+      {
+         // about as many images as vertices
+         double R = sqrt( area / PI );
+         std::string filename = settings._OutFile + ".dual";
+         results.push_back( measure( settings, "exportAsDual", numVertices, [&] { exportAsDual( simulation, R, filename ); return (double) numVertices; } ) );
+         remove( filename.c_str() );
+      }
+
+      if ( wanted( "exportAsPeriodicDual" ) )
+      {
+         std::string filename = settings._OutFile + ".dual";
+         results.push_back( measure( settings, "exportAsPeriodicDual", numVertices, [&] { exportAsPeriodicDual( simulation, filename ); return (double) numVertices; } ) );
+         remove( filename.c_str() );
+      }
+   }
+
+   bool writeResults( const Settings& settings, const std::vector<Result>& results )
+   {
+      FILE* file = fopen( settings._OutFile.c_str(), "wb" );
+      if ( !file )
+         return false;
+      bool ok;
+      {
+         JsonWriter writer( file );
+         writer.beginObject();
+         writer.key( "minSeconds" );
+         writer.value( settings._MinSeconds );
+         writer.key( "results" );
+         writer.beginArray();
+         for ( const Result& result : results )
+         {
+            writer.beginObject();
+            writer.key( "allocationsPerIteration" );
+            writer.value( result._AllocationsPerIteration );
+            writer.key( "bytesPerIteration" );
+            writer.value( result._BytesPerIteration );
+            writer.key( "itemsPerSecond" );
+            writer.value( result._ItemsPerSecond );
+            writer.key( "iterations" );
+            writer.value( result._Iterations );
+            writer.key( "maxSeconds" );
+            writer.value( result._Max );
+            writer.key( "meanSeconds" );
+            writer.value( result._Mean );
+            writer.key( "name" );
+            writer.value( result._Name );
+            writer.key( "p50Seconds" );
+            writer.value( result._P50 );
+            writer.key( "p90Seconds" );
+            writer.value( result._P90 );
+            writer.key( "p99Seconds" );
+            writer.value( result._P99 );
+            writer.key( "vertices" );
+            writer.value( result._NumVertices );
+            writer.endObject();
+         }
+         writer.endArray();
+         writer.key( "threads" );
+         writer.value( settings._NumThreads );
+         writer.endObject();
+         writer.end();
+         ok = writer.flush();
+      }
+      return fclose( file ) == 0 && ok;
+   }
+}
+
+int main( int argc, char* argv[] )
+{
+   Settings settings;
+   for ( int i = 1; i < argc; i++ )
+   {
+      std::string arg = argv[i];
+      if ( i+1 >= argc )
+      {
+         printUsage();
+         return 1;
+      }
+      std::string value = argv[++i];
+      if ( arg == "--sizes" )
+      {
+         settings._Sizes.clear();
+         for ( size_t begin = 0; begin < value.size(); )
+         {
+            size_t end = std::min( value.find( ',', begin ), value.size() );
+            settings._Sizes.push_back( atoi( value.substr( begin, end - begin ).c_str() ) );
+            begin = end + 1;
+         }
+      }
+      else if ( arg == "--min-time" ) settings._MinSeconds = atof( value.c_str() );
+      else if ( arg == "--threads" ) settings._NumThreads = atoi( value.c_str() );
+      else if ( arg == "--filter" ) settings._Filter = value;
+      else if ( arg == "--out" ) settings._OutFile = value;
+      else
+      {
+         printUsage();
+         return 1;
+      }
+   }
+
+   printf( "%-18s %8s %8s %12s %12s %12s %12s %14s %12s %14s\n", "case", "vertices", "iters", "p50 us", "p90 us", "p99 us", "max us", "items/s", "allocs/iter", "bytes/iter" );
+   std::vector<Result> results;
+   for ( int numVertices : settings._Sizes )
+      if ( numVertices > 0 )
+         runCases( settings, numVertices, results );
+
+   if ( !writeResults( settings, results ) )
+   {
+      fprintf( stderr, "cannot write %s\n", settings._OutFile.c_str() );
+      return 1;
+   }
+   printf( "wrote %s\n", settings._OutFile.c_str() );
+   return 0;
+}
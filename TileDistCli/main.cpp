@@ -0,0 +1,290 @@
+#include "Simulation.h"
+#include "SceneFile.h"
+#include "Checkpoint.h"
+#include "DualExport.h"
+#include "DualImport.h"
+#include "Ensemble.h"
+#include "StepScheduler.h"
+#include "Profiler.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace
+{
+   void printUsage()
+   {
+      printf( "usage: TileDistCli <scene file, .tdck checkpoint or periodic .dual export> [options]\n"
+              "       TileDistCli <file.dual>   summarises an exported graph\n"
+              "   --steps <n>            run exactly n steps (default 1000)\n"
+              "   --converge <tol>       run until no vertex moves more than tol in a step\n"
+              "   --max-steps <n>        step limit for --converge (default 1000000) or per --ensemble run (default 20000)\n"
+              "   --tension <t>          override the scene's tension\n"
+              "   --pair-dist <spec>     minimum distances of single colour pairs, e.g. \"0-1:1.5 2-2:3\",\n"
+              "                          added to the scene's\n"
+              "   --symmetry <group>     rotational symmetry p1, p2, p3, p4 or p6, optionally with a colour\n"
+              "                          permutation, e.g. \"p3 1 2 0\"; only one copy of the vertices is stepped\n"
+              "   --method <m>           clamped (steps of force * tension), fire or lbfgs (default clamped)\n"
+              "   --kernel <k>           pair kernel: scalar, simd or float (default simd)\n"
+              "   --threads <n>          worker threads, 0 = one per core (default 0)\n"
+              "   --radius <R>           export radius (default 5)\n"
+              "   --out <file>           output .dual file (default test.dual)\n"
+              "   --periodic             export only the fundamental domain, with neighbours as (index, lattice offset),\n"
+              "                          instead of everything within the radius\n"
+              "   --checkpoint <file>    save a checkpoint when done\n"
+              "   --checkpoint-every <s> also save it every s seconds while stepping\n"
+              "   --ensemble <n>         run n simulations from random layouts and export the best\n"
+              "   --seed <s>             seed of the first ensemble run (default 1)\n"
+              "   --violation <tol>      overlap an ensemble run may have left to count as a success (default 1e-3)\n"
+              "   --cancel-on-success    stop the other ensemble runs once one succeeds\n"
+              "   --trace <file>         write a Chrome trace of the run's phases\n" );
+   }
+
+   bool endsWith( const std::string& str, const std::string& suffix )
+   {
+      return str.size() >= suffix.size() && str.compare( str.size() - suffix.size(), suffix.size(), suffix ) == 0;
+   }
+
+   // writes the trace started for --trace, if any
+   bool finishTrace( const std::string& traceFile )
+   {
+      if ( traceFile.empty() )
+         return true;
+      std::string error;
+      if ( !Profiler::instance().writeTrace( traceFile, error ) )
+      {
+         fprintf( stderr, "%s\n", error.c_str() );
+         return false;
+      }
+      printf( "wrote trace %s\n", traceFile.c_str() );
+      return true;
+   }
+
+   int summariseDual( const std::string& filename )
+   {
+      auto startTime = std::chrono::steady_clock::now();
+      DualGraph graph;
+      std::string error;
+      if ( !importDual( filename, graph, error ) )
+      {
+         fprintf( stderr, "%s\n", error.c_str() );
+         return 1;
+      }
+      double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - startTime ).count();
+
+      std::vector<int> degreeCount;
+      for ( int i = 0; i < (int) graph._Vertices.size(); i++ )
+      {
+         int degree = graph._Start[i+1] - graph._Start[i];
+         if ( degree >= (int) degreeCount.size() )
+            degreeCount.resize( degree + 1 );
+         degreeCount[degree]++;
+      }
+      printf( "%d vertices, %d neighbour entries, read in %.3f s\n", (int) graph._Vertices.size(), (int) graph._Neighbor.size(), seconds );
+      if ( graph._Periodic )
+         printf( "periodic in u = (%g, %g), v = (%g, %g)\n", graph._U.x, graph._U.y, graph._V.x, graph._V.y );
+      for ( int degree = 0; degree < (int) degreeCount.size(); degree++ )
+         if ( degreeCount[degree] > 0 )
+            printf( "   degree %2d: %d\n", degree, degreeCount[degree] );
+      return 0;
+   }
+
+   // exports the whole pattern the simulation's vertices stand for
+   bool exportSimulation( const Simulation& simulation, double R, bool periodic, const std::string& outFile )
+   {
+      PeriodicVertices images;
+      simulation.images( images );
+      return periodic ? exportAsPeriodicDual( images, outFile, simulation._Symmetry ) : exportAsDual( images, R, outFile, simulation._Symmetry );
+   }
+
+   int runEnsemble( Simulation& simulation, const EnsembleSettings& settings, double R, bool periodic, const std::string& outFile )
+   {
+      auto startTime = std::chrono::steady_clock::now();
+      std::vector<EnsembleRun> runs = Ensemble( settings ).run( simulation );
+      double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - startTime ).count();
+
+      printf( "%d runs of %d vertices in %.3f s\n", (int) runs.size(), (int) simulation._Vertices.size(), seconds );
+      printf( "rank   run                 seed    steps    violation       energy\n" );
+      for ( int i = 0; i < (int) runs.size(); i++ )
+      {
+         const EnsembleRun& run = runs[i];
+         printf( "%4d %5d %20llu %8d %12.4g %12.4g %s\n", i+1, run._Index, (unsigned long long) run._Seed, run._Steps, run._Violation, run._Energy,
+                 run._Success ? "success" : run._Cancelled ? "cancelled" : "" );
+      }
+      if ( runs.empty() )
+         return 1;
+
+      Ensemble::apply( runs[0], simulation );
+      if ( !exportSimulation( simulation, R, periodic, outFile ) )
+      {
+         fprintf( stderr, "cannot write %s\n", outFile.c_str() );
+         return 1;
+      }
+      printf( "wrote run %d to %s\n", runs[0]._Index, outFile.c_str() );
+      return runs[0]._Success ? 0 : 2;
+   }
+}
+
+int main( int argc, char* argv[] )
+{
+   if ( argc < 2 )
+   {
+      printUsage();
+      return 1;
+   }
+
+   std::string sceneFile = argv[1];
+   if ( endsWith( sceneFile, ".dual" ) && argc == 2 )
+      return summariseDual( sceneFile );
+   int numSteps = 1000;
+   int maxSteps = -1;
+   double tolerance = -1;
+   double tension = -1;
+   std::string pairDistances;
+   std::string symmetry;
+   int numThreads = 0;
+   Simulation::Kernel kernel = Simulation::SIMD_DOUBLE;
+   Simulation::Method method = Simulation::CLAMPED;
+   double R = 5;
+   bool periodic = false;
+   std::string outFile = "test.dual";
+   std::string checkpointFile;
+   double checkpointSeconds = 0;
+   std::string traceFile;
+   EnsembleSettings ensembleSettings;
+   ensembleSettings._NumRuns = 0;
+
+   for ( int i = 2; i < argc; i++ )
+   {
+      std::string arg = argv[i];
+      if ( arg == "--cancel-on-success" )
+      {
+         ensembleSettings._CancelOnSuccess = true;
+         continue;
+      }
+      if ( arg == "--periodic" )
+      {
+         periodic = true;
+         continue;
+      }
+      if ( i+1 >= argc )
+      {
+         printUsage();
+         return 1;
+      }
+      std::string value = argv[++i];
+      if ( arg == "--steps" ) numSteps = atoi( value.c_str() );
+      else if ( arg == "--converge" ) tolerance = atof( value.c_str() );
+      else if ( arg == "--max-steps" ) maxSteps = atoi( value.c_str() );
+      else if ( arg == "--tension" ) tension = atof( value.c_str() );
+      else if ( arg == "--pair-dist" ) pairDistances = value;
+      else if ( arg == "--symmetry" ) symmetry = value;
+      else if ( arg == "--method" && value == "clamped" ) method = Simulation::CLAMPED;
+      else if ( arg == "--method" && value == "fire" ) method = Simulation::FIRE;
+      else if ( arg == "--method" && value == "lbfgs" ) method = Simulation::LBFGS;
+      else if ( arg == "--kernel" && value == "scalar" ) kernel = Simulation::SCALAR;
+      else if ( arg == "--kernel" && value == "simd" ) kernel = Simulation::SIMD_DOUBLE;
+      else if ( arg == "--kernel" && value == "float" ) kernel = Simulation::SIMD_FLOAT;
+      else if ( arg == "--threads" ) numThreads = atoi( value.c_str() );
+      else if ( arg == "--radius" ) R = atof( value.c_str() );
+      else if ( arg == "--out" ) outFile = value;
+      else if ( arg == "--checkpoint" ) checkpointFile = value;
+      else if ( arg == "--checkpoint-every" ) checkpointSeconds = atof( value.c_str() );
+      else if ( arg == "--ensemble" ) ensembleSettings._NumRuns = atoi( value.c_str() );
+      else if ( arg == "--seed" ) ensembleSettings._Seed = strtoull( value.c_str(), nullptr, 10 );
+      else if ( arg == "--violation" ) ensembleSettings._Tolerance = atof( value.c_str() );
+      else if ( arg == "--trace" ) traceFile = value;
+      else
+      {
+         printUsage();
+         return 1;
+      }
+   }
+
+   if ( !traceFile.empty() )
+      Profiler::instance().startTrace();
+
+   Simulation simulation;
+   std::string error;
+   bool loaded = endsWith( sceneFile, ".tdck" ) ? loadCheckpoint( sceneFile, simulation, error )
+               : endsWith( sceneFile, ".dual" ) ? loadDual( sceneFile, simulation, error )
+               : loadScene( sceneFile, simulation, error );
+   if ( !loaded )
+   {
+      fprintf( stderr, "%s\n", error.c_str() );
+      return 1;
+   }
+   if ( tension >= 0 )
+      simulation._Tension = tension;
+   PairDistances extraPairDistances;
+   if ( !extraPairDistances.parse( pairDistances, error ) )
+   {
+      fprintf( stderr, "%s\n", error.c_str() );
+      return 1;
+   }
+   for ( const PairDistances::Entry& e : extraPairDistances.entries() )
+      simulation._PairDistances.set( e._ColorA, e._ColorB, e._MinDist );
+   if ( !symmetry.empty() )
+   {
+      Symmetry parsed;
+      if ( !parsed.parse( symmetry, error ) || !simulation.setSymmetry( parsed, error ) )
+      {
+         fprintf( stderr, "%s\n", error.c_str() );
+         return 1;
+      }
+   }
+   simulation.setNumThreads( numThreads );
+   simulation._Kernel = kernel;
+   simulation._Method = method;
+   if ( method == Simulation::CLAMPED && simulation._Tension <= 0 )
+      fprintf( stderr, "warning: tension is 0, vertices will not move\n" );
+
+   if ( ensembleSettings._NumRuns > 0 )
+   {
+      if ( maxSteps >= 0 )
+         ensembleSettings._MaxSteps = maxSteps;
+      ensembleSettings._NumThreads = numThreads;
+      int ret = runEnsemble( simulation, ensembleSettings, R, periodic, outFile );
+      return finishTrace( traceFile ) ? ret : 1;
+   }
+
+   if ( maxSteps < 0 )
+      maxSteps = 1000000;
+   StepScheduler scheduler;
+   scheduler._SettleSteps = 1;
+   scheduler._Tolerance = tolerance;
+   if ( tolerance < 0 )
+      maxSteps = numSteps;
+
+   StepScheduler::Clock::duration budget = StepScheduler::Clock::duration::max();
+   if ( !checkpointFile.empty() && checkpointSeconds > 0 )
+      budget = std::chrono::duration_cast<StepScheduler::Clock::duration>( std::chrono::duration<double>( checkpointSeconds ) );
+
+   auto startTime = std::chrono::steady_clock::now();
+   int stepsDone = 0;
+   do
+   {
+      stepsDone += scheduler.run( simulation, budget, maxSteps - stepsDone );
+      if ( !checkpointFile.empty() && !saveCheckpoint( simulation, checkpointFile, error ) )
+      {
+         fprintf( stderr, "%s\n", error.c_str() );
+         return 1;
+      }
+   } while ( stepsDone < maxSteps && !scheduler.settled() );
+   double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - startTime ).count();
+
+   printf( "%d vertices, %d threads, %d steps in %.3f s (%.0f steps/s)%s\n", (int) simulation._Vertices.size(), simulation.numThreads(), stepsDone, seconds, seconds > 0 ? stepsDone / seconds : 0., scheduler.settled() ? ", converged" : "" );
+   const StepStats& stats = scheduler.lastStats();
+   printf( "last step: max displacement %g, rms displacement %g, energy %g\n", stats._MaxDisplacement, stats._RmsDisplacement, stats._Energy );
+   printf( "%lld force evaluations\n", scheduler.numEvaluations() );
+
+   if ( !exportSimulation( simulation, R, periodic, outFile ) )
+   {
+      fprintf( stderr, "cannot write %s\n", outFile.c_str() );
+      return 1;
+   }
+   printf( "wrote %s\n", outFile.c_str() );
+   return finishTrace( traceFile ) ? 0 : 1;
+}
@@ -0,0 +1,143 @@
+#include "CellList.h"
+
+#include <algorithm>
+
+namespace
+{
+   const int MAX_CELLS_PER_SIDE = 1024;
+   // how many bins the stencil may reach out in each direction; only absurd cutoffs, hundreds of times the
+   // lattice's width, would need more and lose their furthest images
+   const int MAX_REACH = 256;
+   // beyond this, with the cutoff just under half the width, finer bins would cost more than the repeated visits
+   const int MAX_CELLS_WITHOUT_WRAP = 32;
+
+   int numCells( double width, double cutoff )
+   {
+      if ( !(cutoff > 0) || !(width > 0) )
+         return 1;
+      return (int) std::max( 1., std::min( (double) MAX_CELLS_PER_SIDE, floor( width / cutoff ) ) );
+   }
+   // With width > 2 * cutoff a point has at most one image within cutoff of another point along this direction.
+   // More, narrower bins then keep the stencil from wrapping around onto bins it already holds, which would
+   // visit their points again at images out of range.
+   int numCellsWithoutWrap( double width, double cutoff, int numCells )
+   {
+      if ( !( 2 * cutoff < width ) )
+         return numCells;
+      for ( int n = numCells; n <= MAX_CELLS_WITHOUT_WRAP; n++ )
+         if ( n >= 2 * (int) ceil( cutoff * n / width ) + 1 )
+            return n;
+      return numCells;
+   }
+   int clampCell( double t, int n )
+   {
+      if ( !(t >= 0) ) return 0; // also catches NaN from a degenerate lattice
+      return std::min( n - 1, (int) ( t * n ) );
+   }
+   // bins to each side that a cutoff spans
+   int reach( double cellWidth, double cutoff )
+   {
+      if ( !(cutoff > 0) || !(cellWidth > 0) )
+         return 1;
+      return (int) std::max( 1., std::min( (double) MAX_REACH, ceil( cutoff / cellWidth ) ) );
+   }
+   double segmentDist2( const XYZ& p, const XYZ& a, const XYZ& b )
+   {
+      XYZ ab = b - a;
+      double t = std::max( 0., std::min( 1., ( ( p - a ) * ab ) / ab.len2() ) );
+      return p.dist2( a + ab * t );
+   }
+}
+
+void CellList::build( const std::vector<XYZ>& positions, const XYZ& u, const XYZ& v, double cutoff )
+{
+   _Lattice = Lattice2D( u, v ).reduced( _ToOriginal );
+   _U = _Lattice.u();
+   _V = _Lattice.v();
+
+   double det = _U.x * _V.y - _U.y * _V.x;
+   double area = fabs( det );
+   double widthU = area / _V.len(); // distance between the two sides parallel to v
+   double widthV = area / _U.len();
+   _NumU = numCellsWithoutWrap( widthU, cutoff, numCells( widthU, cutoff ) );
+   _NumV = numCellsWithoutWrap( widthV, cutoff, numCells( widthV, cutoff ) );
+   buildStencil( cutoff );
+
+   int n = (int) positions.size();
+   _Pos.resize( n );
+   _CellU.resize( n );
+   _CellV.resize( n );
+   _CellStart.assign( _NumU * _NumV + 1, 0 );
+   _CellItems.resize( n );
+   _Slot.resize( n );
+   _WrapU.resize( n );
+   _WrapV.resize( n );
+
+   for ( int i = 0; i < n; i++ )
+   {
+      const XYZ& p = positions[i];
+      XYZ ab = _Lattice.toLattice( p );
+      double a = ab.x;
+      double b = ab.y;
+      double fa = floor( a );
+      double fb = floor( b );
+      if ( std::isfinite( fa ) && std::isfinite( fb ) )
+      {
+         a -= fa;
+         b -= fb;
+         _Pos[i] = p - _U * fa - _V * fb;
+         _WrapU[i] = (int) -fa;
+         _WrapV[i] = (int) -fb;
+      }
+      else
+      {
+         _Pos[i] = p;
+         _WrapU[i] = 0;
+         _WrapV[i] = 0;
+      }
+      _CellU[i] = clampCell( a, _NumU );
+      _CellV[i] = clampCell( b, _NumV );
+      _CellStart[_CellV[i] * _NumU + _CellU[i] + 1]++;
+   }
+
+   // counting sort of the points by cell
+   for ( int c = 0; c < _NumU * _NumV; c++ )
+      _CellStart[c+1] += _CellStart[c];
+   std::vector<int> fill( _CellStart.begin(), _CellStart.end() - 1 );
+   for ( int i = 0; i < n; i++ )
+   {
+      _Slot[i] = fill[_CellV[i] * _NumU + _CellU[i]]++;
+      _CellItems[_Slot[i]] = i;
+   }
+}
+
+void CellList::buildStencil( double cutoff )
+{
+   _Stencil.clear();
+   double area = fabs( _U.x * _V.y - _U.y * _V.x );
+   XYZ cellU = _U / _NumU;
+   XYZ cellV = _V / _NumV;
+   int reachU = reach( area / _V.len() / _NumU, cutoff );
+   int reachV = reach( area / _U.len() / _NumV, cutoff );
+   for ( int dv = -reachV; dv <= reachV; dv++ )
+   {
+      for ( int du = -reachU; du <= reachU; du++ )
+      {
+         // differences of points in two bins du, dv apart fill the parallelogram centre +- cellU +- cellV,
+         // which contains 0 for the 8 bins around; leave out the bins it keeps further than cutoff away
+         if ( du == 0 && dv == 0 )
+            continue;
+         if ( abs( du ) > 1 || abs( dv ) > 1 )
+         {
+            XYZ centre = cellU * du + cellV * dv;
+            XYZ corners[4] = { centre - cellU - cellV, centre + cellU - cellV, centre + cellU + cellV, centre - cellU + cellV };
+            double dist2 = INFINITY;
+            for ( int k = 0; k < 4; k++ )
+               dist2 = std::min( dist2, segmentDist2( XYZ(), corners[k], corners[( k + 1 ) % 4] ) );
+            if ( sqrt( dist2 ) > cutoff * ( 1 + 1e-9 ) )
+               continue;
+         }
+         _Stencil.push_back( StencilCell{ du, dv } );
+      }
+   }
+}
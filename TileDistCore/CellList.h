@@ -0,0 +1,138 @@
+#pragma once
+
+#include "DataTypes.h"
+#include <cmath>
+#include <vector>
+
+// Periodic bin grid over the lattice spanned by u and v. The grid is laid over the Gauss-reduced basis of the
+// lattice, whose parallelogram is as wide as the lattice allows, so a skewed u, v costs nothing. Bins are about
+// `cutoff` wide (measured perpendicular to their sides); a point's neighbours are looked up in a stencil of
+// exactly the bins that come within `cutoff` of its own, reaching as far as the cutoff needs. Where the
+// parallelogram is more than twice the cutoff wide, only one image of a point can be in range and the bins are
+// made small enough that the stencil never meets the same bin twice, so every pair is visited once, at its
+// minimum image, instead of once per image of a 3x3 block.
+class CellList
+{
+public:
+   void build( const std::vector<XYZ>& positions, const XYZ& u, const XYZ& v, double cutoff );
+
+   int size() const { return (int) _Pos.size(); }
+   // position of point i wrapped into the parallelogram of the reduced basis
+   const XYZ& pos( int i ) const { return _Pos[i]; }
+
+   // points sorted by cell: slot k holds point item( k ), and point i sits in slot slot( i )
+   int item( int k ) const { return _CellItems[k]; }
+   int slot( int i ) const { return _Slot[i]; }
+
+   // calls f( begin, end, offset ) for the slot ranges of the cells around point i, where offset is the
+   // lattice translation of that cell's image. Point i's own slot is left out.
+   template<typename F> void forEachNeighborCell( int i, F f ) const
+   {
+      int cellU = _CellU[i];
+      int cellV = _CellV[i];
+      int own = cellV * _NumU + cellU;
+      f( _CellStart[own], _Slot[i], XYZ() );
+      f( _Slot[i] + 1, _CellStart[own+1], XYZ() );
+      for ( const StencilCell& s : _Stencil )
+      {
+         int cu = cellU + s._DU;
+         int cv = cellV + s._DV;
+         // almost always within one grid width, where this beats a division
+         int su = cu < 0 ? -1 : cu >= _NumU ? 1 : 0;
+         int sv = cv < 0 ? -1 : cv >= _NumV ? 1 : 0;
+         if ( cu < -_NumU || cu >= 2 * _NumU )
+            su = floorDiv( cu, _NumU );
+         if ( cv < -_NumV || cv >= 2 * _NumV )
+            sv = floorDiv( cv, _NumV );
+         cu -= su * _NumU;
+         cv -= sv * _NumV;
+         int cell = cv * _NumU + cu;
+         f( _CellStart[cell], _CellStart[cell+1], _U * su + _V * sv );
+      }
+   }
+
+   // calls f( j, posJ ) for every image of every point that may lie within `cutoff` of point i (excluding point i itself)
+   template<typename F> void forEachNeighbor( int i, F f ) const
+   {
+      forEachNeighborCell( i, [&]( int begin, int end, const XYZ& offset )
+      {
+         for ( int k = begin; k < end; k++ )
+         {
+            int j = _CellItems[k];
+            f( j, _Pos[j] + offset );
+         }
+      } );
+   }
+
+   // calls f( i, posI, su, sv ) for every image of every point within r of p, where posI is that image and
+   // (su, sv) the lattice translation, in multiples of u and v, taking point i's original position to it
+   template<typename F> void forEachInRange( const XYZ& p, double r, F f ) const
+   {
+      if ( _Pos.empty() || !(r >= 0) )
+         return;
+      double det = _U.x * _V.y - _U.y * _V.x;
+      XYZ ab = _Lattice.toLattice( p );
+      double a = ab.x;
+      double b = ab.y;
+      // how far the lattice coordinates can change within r
+      double ra = r * _V.len() / fabs( det );
+      double rb = r * _U.len() / fabs( det );
+      if ( !std::isfinite( a ) || !std::isfinite( b ) || !std::isfinite( ra ) || !std::isfinite( rb ) )
+         return;
+      for ( int cv = (int) floor( ( b - rb ) * _NumV ); cv <= (int) floor( ( b + rb ) * _NumV ); cv++ )
+      {
+         int sv = floorDiv( cv, _NumV );
+         for ( int cu = (int) floor( ( a - ra ) * _NumU ); cu <= (int) floor( ( a + ra ) * _NumU ); cu++ )
+         {
+            int su = floorDiv( cu, _NumU );
+            XYZ offset = _U * su + _V * sv;
+            int cell = ( cv - sv * _NumV ) * _NumU + cu - su * _NumU;
+            for ( int k = _CellStart[cell]; k < _CellStart[cell+1]; k++ )
+            {
+               int i = _CellItems[k];
+               XYZ posI = _Pos[i] + offset;
+               if ( posI.dist2( p ) <= r*r )
+               {
+                  // the translation in the caller's basis
+                  XYZ ab = _ToOriginal.linear( XYZ( su + _WrapU[i], sv + _WrapV[i], 0 ) );
+                  f( i, posI, (int) lround( ab.x ), (int) lround( ab.y ) );
+               }
+            }
+         }
+      }
+   }
+
+private:
+   class StencilCell
+   {
+   public:
+      int _DU;
+      int _DV;
+   };
+
+private:
+   static int floorDiv( int a, int n ) { return a >= 0 ? a / n : -( ( n - 1 - a ) / n ); }
+
+   // fills _Stencil with the bins around a point's own, which itself is left out
+   void buildStencil( double cutoff );
+
+private:
+   // the reduced basis
+   XYZ _U;
+   XYZ _V;
+   Lattice2D _Lattice;
+   // reduced lattice coordinates to those of the u, v given to build()
+   Affine2D _ToOriginal;
+   std::vector<StencilCell> _Stencil;
+   int _NumU = 1;
+   int _NumV = 1;
+   std::vector<XYZ> _Pos;
+   std::vector<int> _CellU;
+   std::vector<int> _CellV;
+   std::vector<int> _CellStart;
+   std::vector<int> _CellItems;
+   std::vector<int> _Slot;
+   // lattice translation from the original position to pos( i ), in the reduced basis
+   std::vector<int> _WrapU;
+   std::vector<int> _WrapV;
+};
@@ -0,0 +1,278 @@
+#include "Checkpoint.h"
+#include "MappedFile.h"
+#include "Simulation.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+   const char MAGIC[4] = { 'T', 'D', 'C', 'K' };
+   const uint32_t VERSION = 3;
+
+   class CheckpointHeader
+   {
+   public:
+      char _Magic[4];
+      uint32_t _Version;
+      uint64_t _NumVertices;
+      double _U[2];
+      double _V[2];
+      double _MinDistanceAllowed;
+      double _MinDistanceAllowed_SameColor;
+      double _Tension;
+   };
+   static_assert( sizeof( CheckpointHeader ) == 72, "checkpoint header must not contain padding" );
+
+   const size_t BYTES_PER_VERTEX = 2 * sizeof( double ) + sizeof( int32_t );
+
+   class CheckpointPairDistance
+   {
+   public:
+      int32_t _ColorA;
+      int32_t _ColorB;
+      double _MinDist;
+   };
+   static_assert( sizeof( CheckpointPairDistance ) == 16, "checkpoint pair distance must not contain padding" );
+
+   class CheckpointSymmetry
+   {
+   public:
+      int32_t _Order;
+      int32_t _NumPermutedColors;
+   };
+   static_assert( sizeof( CheckpointSymmetry ) == 8, "checkpoint symmetry must not contain padding" );
+
+   bool syncToDisk( FILE* f )
+   {
+      if ( fflush( f ) != 0 )
+         return false;
+#ifdef _WIN32
+      return _commit( _fileno( f ) ) == 0;
+#else
+      return fsync( fileno( f ) ) == 0;
+#endif
+   }
+
+   // writes one column of the vertex table through a small buffer
+   template<typename T, typename Get>
+   bool writeColumn( FILE* f, const std::vector<Vertex>& vertices, Get get )
+   {
+      const size_t BUFFER_SIZE = 4096;
+      T buffer[BUFFER_SIZE];
+      for ( size_t begin = 0; begin < vertices.size(); begin += BUFFER_SIZE )
+      {
+         size_t n = std::min( BUFFER_SIZE, vertices.size() - begin );
+         for ( size_t i = 0; i < n; i++ )
+            buffer[i] = get( vertices[begin + i] );
+         if ( fwrite( buffer, sizeof( T ), n, f ) != n )
+            return false;
+      }
+      return true;
+   }
+}
+
+bool saveCheckpoint( const Simulation& simulation, const std::string& filename, std::string& error )
+{
+   CheckpointHeader header;
+   memcpy( header._Magic, MAGIC, sizeof( MAGIC ) );
+   header._Version = VERSION;
+   header._NumVertices = simulation._Vertices.size();
+   header._U[0] = simulation._U.x;
+   header._U[1] = simulation._U.y;
+   header._V[0] = simulation._V.x;
+   header._V[1] = simulation._V.y;
+   header._MinDistanceAllowed = simulation._MinDistanceAllowed;
+   header._MinDistanceAllowed_SameColor = simulation._MinDistanceAllowed_SameColor;
+   header._Tension = simulation._Tension;
+
+   // loadCheckpoint() would refuse the file
+   if ( !simulation._Symmetry.fits( simulation._Lattice ) )
+   {
+      error = "cannot save " + filename + ": the symmetry doesn't fit the lattice";
+      return false;
+   }
+
+   std::string tempFilename = filename + ".tmp";
+   FILE* f = fopen( tempFilename.c_str(), "wb" );
+   if ( !f )
+   {
+      error = "cannot create " + tempFilename;
+      return false;
+   }
+   const std::vector<Vertex>& vertices = simulation._Vertices;
+   std::vector<CheckpointPairDistance> pairDistances;
+   for ( const PairDistances::Entry& e : simulation._PairDistances.entries() )
+      pairDistances.push_back( CheckpointPairDistance{ e._ColorA, e._ColorB, e._MinDist } );
+   uint64_t numPairDistances = pairDistances.size();
+   const Perm& colorPerm = simulation._Symmetry.colorPerm();
+   CheckpointSymmetry symmetry { simulation._Symmetry.order(), (int32_t) colorPerm.v.size() };
+   std::vector<int32_t> permutedColors( colorPerm.v.begin(), colorPerm.v.end() );
+   bool ok = fwrite( &header, sizeof( header ), 1, f ) == 1
+      && writeColumn<double>( f, vertices, []( const Vertex& a ) { return a._Pos.x; } )
+      && writeColumn<double>( f, vertices, []( const Vertex& a ) { return a._Pos.y; } )
+      && writeColumn<int32_t>( f, vertices, []( const Vertex& a ) { return (int32_t) a._Color; } )
+      && fwrite( &numPairDistances, sizeof( numPairDistances ), 1, f ) == 1
+      && fwrite( pairDistances.data(), sizeof( CheckpointPairDistance ), pairDistances.size(), f ) == pairDistances.size()
+      && fwrite( &symmetry, sizeof( symmetry ), 1, f ) == 1
+      && fwrite( permutedColors.data(), sizeof( int32_t ), permutedColors.size(), f ) == permutedColors.size()
+      && syncToDisk( f );
+   ok = fclose( f ) == 0 && ok;
+   if ( !ok )
+   {
+      error = "cannot write " + tempFilename;
+      remove( tempFilename.c_str() );
+      return false;
+   }
+
+   std::error_code ec;
+   std::filesystem::rename( tempFilename, filename, ec );
+   if ( ec )
+   {
+      error = "cannot replace " + filename + ": " + ec.message();
+      remove( tempFilename.c_str() );
+      return false;
+   }
+   return true;
+}
+
+bool loadCheckpoint( const std::string& filename, Simulation& simulation, std::string& error )
+{
+   MappedFile file;
+   if ( !file.open( filename, error ) )
+      return false;
+
+   CheckpointHeader header;
+   if ( file.size() < sizeof( header ) )
+   {
+      error = filename + " is not a checkpoint";
+      return false;
+   }
+   memcpy( &header, file.data(), sizeof( header ) );
+   if ( memcmp( header._Magic, MAGIC, sizeof( MAGIC ) ) != 0 )
+   {
+      error = filename + " is not a checkpoint";
+      return false;
+   }
+   if ( header._Version > VERSION )
+   {
+      error = filename + " was written by a newer version (" + std::to_string( header._Version ) + ")";
+      return false;
+   }
+   if ( header._NumVertices > ( file.size() - sizeof( header ) ) / BYTES_PER_VERTEX )
+   {
+      error = filename + " is truncated or corrupt";
+      return false;
+   }
+   // version 1 ends after the vertices, version 2 after the pair distances
+   size_t verticesEnd = sizeof( header ) + (size_t) header._NumVertices * BYTES_PER_VERTEX;
+   size_t end = verticesEnd;
+   uint64_t numPairDistances = 0;
+   if ( header._Version >= 2 )
+   {
+      if ( file.size() >= end + sizeof( numPairDistances ) )
+         memcpy( &numPairDistances, file.data() + end, sizeof( numPairDistances ) );
+      if ( file.size() < end + sizeof( numPairDistances )
+        || numPairDistances > ( file.size() - end - sizeof( numPairDistances ) ) / sizeof( CheckpointPairDistance ) )
+      {
+         error = filename + " is truncated or corrupt";
+         return false;
+      }
+      end += sizeof( numPairDistances ) + (size_t) numPairDistances * sizeof( CheckpointPairDistance );
+   }
+   CheckpointSymmetry symmetryHeader { 1, 0 };
+   size_t symmetryEnd = end;
+   if ( header._Version >= 3 )
+   {
+      if ( file.size() >= end + sizeof( symmetryHeader ) )
+         memcpy( &symmetryHeader, file.data() + end, sizeof( symmetryHeader ) );
+      if ( file.size() < end + sizeof( symmetryHeader ) || symmetryHeader._NumPermutedColors < 0
+        || (size_t) symmetryHeader._NumPermutedColors > ( file.size() - end - sizeof( symmetryHeader ) ) / sizeof( int32_t ) )
+      {
+         error = filename + " is truncated or corrupt";
+         return false;
+      }
+      symmetryEnd = end + sizeof( symmetryHeader ) + symmetryHeader._NumPermutedColors * sizeof( int32_t );
+   }
+   if ( file.size() != symmetryEnd )
+   {
+      error = filename + " is truncated or corrupt";
+      return false;
+   }
+
+   size_t n = (size_t) header._NumVertices;
+   const char* xs = file.data() + sizeof( header );
+   const char* ys = xs + n * sizeof( double );
+   const char* colors = ys + n * sizeof( double );
+
+   std::vector<Vertex> vertices( n );
+   for ( size_t i = 0; i < n; i++ )
+   {
+      Vertex& a = vertices[i];
+      int32_t color;
+      memcpy( &a._Pos.x, xs + i * sizeof( double ), sizeof( double ) );
+      memcpy( &a._Pos.y, ys + i * sizeof( double ), sizeof( double ) );
+      memcpy( &color, colors + i * sizeof( int32_t ), sizeof( int32_t ) );
+      a._Pos.z = 0;
+      a._Color = color;
+      a._Index = (int) i;
+      if ( color < 0 )
+      {
+         error = filename + " is corrupt: negative colour";
+         return false;
+      }
+   }
+
+   PairDistances pairDistances;
+   const char* pairs = file.data() + verticesEnd + sizeof( numPairDistances );
+   for ( size_t i = 0; i < numPairDistances; i++ )
+   {
+      CheckpointPairDistance pair;
+      memcpy( &pair, pairs + i * sizeof( pair ), sizeof( pair ) );
+      if ( pair._ColorA < 0 || pair._ColorB < 0 || !( pair._MinDist >= 0 ) )
+      {
+         error = filename + " is corrupt: bad pair distance";
+         return false;
+      }
+      pairDistances.set( pair._ColorA, pair._ColorB, pair._MinDist );
+   }
+
+   Perm colorPerm;
+   const char* permutedColors = file.data() + end + sizeof( symmetryHeader );
+   for ( int i = 0; i < symmetryHeader._NumPermutedColors; i++ )
+   {
+      int32_t color;
+      memcpy( &color, permutedColors + i * sizeof( color ), sizeof( color ) );
+      colorPerm.v.push_back( color );
+   }
+   XYZ u( header._U[0], header._U[1], 0 );
+   XYZ v( header._V[0], header._V[1], 0 );
+   Symmetry symmetry;
+   if ( !symmetry.set( symmetryHeader._Order, colorPerm, error ) || !symmetry.fits( Lattice2D( u, v ) ) )
+   {
+      error = filename + " is corrupt: bad symmetry";
+      return false;
+   }
+
+   simulation._ClickedVertex = VertexPtr();
+   simulation._Vertices.swap( vertices );
+   // before setUV(), which keeps the vertices off the centres of this symmetry's rotations
+   simulation._Symmetry = symmetry;
+   simulation._ClickedElement = 0;
+   simulation.setUV( u, v );
+   simulation._MinDistanceAllowed = header._MinDistanceAllowed;
+   simulation._MinDistanceAllowed_SameColor = header._MinDistanceAllowed_SameColor;
+   simulation._PairDistances = pairDistances;
+   simulation._Tension = header._Tension;
+   return true;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+
+class Simulation;
+
+// Binary snapshot of a Simulation's vertices, lattice, minimum distances, tension and symmetry, meant for frequent
+// saving of large states. Little-endian layout:
+//    CheckpointHeader (72 bytes)
+//    double x[numVertices]
+//    double y[numVertices]
+//    int32  color[numVertices]
+//    uint64 numPairDistances                             (version 2)
+//    { int32 colorA, int32 colorB, double d }[numPairDistances]
+//    int32  symmetryOrder, int32 numPermutedColors             (version 3)
+//    int32  colorPerm[numPermutedColors]
+// The file is replaced atomically, so a crash while saving leaves the previous checkpoint intact. Nothing is written
+// if the symmetry doesn't fit the lattice, which loadCheckpoint() would reject.
+bool saveCheckpoint( const Simulation& simulation, const std::string& filename, std::string& error );
+// replaces simulation's vertices and settings; older versions of the format are read, newer ones rejected
+bool loadCheckpoint( const std::string& filename, Simulation& simulation, std::string& error );
@@ -1,5 +1,7 @@
 #include "DataTypes.h"
 
+#include <algorithm>
+
 bool XYZW::eq( const XYZW& rhs, double tolerance ) const
 {
    return abs( x - rhs.x ) <= tolerance
@@ -55,13 +57,17 @@ bool Matrix4x4::eq( const Matrix4x4& rhs, double tolerance ) const
 
 XYZ::XYZ( const Json& json ) { x = json[0].toDouble(); y = json[1].toDouble(); z = json[2].toDouble(); }
 
-Json XYZ::toJson() const { return JsonArray( {x,y,z} ); }
-Json XYZW::toJson() const { return JsonArray( {x,y,z,w} ); }
+Json XYZ::toJson() const { Json ret( Json::ARRAY ); ret.reserve( 3 ); ret.push_back( x ); ret.push_back( y ); ret.push_back( z ); return ret; }
+Json XYZW::toJson() const { Json ret( Json::ARRAY ); ret.reserve( 4 ); ret.push_back( x ); ret.push_back( y ); ret.push_back( z ); ret.push_back( w ); return ret; }
 XYZW::XYZW( const Json& json ) { x=json[0].toDouble(); y=json[1].toDouble(); z=json[2].toDouble(); w=json[3].toDouble();  }
 
 Json Matrix4x4::toJson() const
 {
-   return JsonArray( {m[0].toJson(),m[1].toJson(),m[2].toJson(),m[3].toJson()} );
+   Json ret( Json::ARRAY );
+   ret.reserve( 4 );
+   for ( const XYZW& row : m )
+      ret.push_back( row.toJson() );
+   return ret;
 }
 Matrix4x4::Matrix4x4( const Json& json )
 {
@@ -69,4 +75,38 @@ Matrix4x4::Matrix4x4( const Json& json )
    m[1] = XYZW( json[1] );
    m[2] = XYZW( json[2] );
    m[3] = XYZW( json[3] );
-}
\ No newline at end of file
+}
+
+Lattice2D Lattice2D::reduced( Affine2D& toOriginal ) const
+{
+   toOriginal = Affine2D();
+   XYZ a = u();
+   XYZ b = v();
+   if ( !( fabs( _ToCartesian.det() ) > 0 ) )
+      return *this;
+
+   // columns: coordinates of a and b in this basis
+   double m00 = 1, m01 = 0, m10 = 0, m11 = 1;
+   auto swapVectors = [&]()
+   {
+      std::swap( a, b );
+      std::swap( m00, m01 );
+      std::swap( m10, m11 );
+   };
+   if ( a.len2() > b.len2() )
+      swapVectors();
+   // converges in a few rounds; the limit only guards against rounding trouble
+   for ( int i = 0; i < 64; i++ )
+   {
+      double mu = round( ( a * b ) / a.len2() );
+      b -= a * mu;
+      m01 -= mu * m00;
+      m11 -= mu * m10;
+      if ( b.len2() >= a.len2() )
+         break;
+      swapVectors();
+   }
+   toOriginal = Affine2D( m00, m01, m10, m11, 0, 0 );
+   // from the integer coordinates, free of the rounding the subtractions collected
+   return Lattice2D( u() * m00 + v() * m10, u() * m01 + v() * m11 );
+}
@@ -12,10 +12,9 @@
 class CORE_API XYZ
 {
 public:
-   XYZ( double px, double py, double pz ) { set( px, py, pz ); }
-   XYZ() { set( 0, 0, 0 ); }
+   constexpr XYZ( double px, double py, double pz ) : x( px ), y( py ), z( pz ) {}
+   constexpr XYZ() : x( 0 ), y( 0 ), z( 0 ) {}
    XYZ( const Json& json );
-   ~XYZ() {}
    void set( double px, double py, double pz ) { x = px; y = py; z = pz; }
 
    double len2() const { return x*x + y*y + z*z; }
@@ -131,6 +130,67 @@ public:
    XYZW m[4];
 };
 
+// 2D affine map p -> ( m00 * p.x + m01 * p.y + tx, m10 * p.x + m11 * p.y + ty ); z passes through unchanged.
+// Six numbers instead of a Matrix4x4 for the maps the drawing and the lattice need.
+class CORE_API Affine2D
+{
+public:
+   constexpr Affine2D() : m00( 1 ), m01( 0 ), m10( 0 ), m11( 1 ), tx( 0 ), ty( 0 ) {}
+   constexpr Affine2D( double m00, double m01, double m10, double m11, double tx, double ty ) : m00( m00 ), m01( m01 ), m10( m10 ), m11( m11 ), tx( tx ), ty( ty ) {}
+   static constexpr Affine2D scale( double sx, double sy ) { return Affine2D( sx, 0, 0, sy, 0, 0 ); }
+   static constexpr Affine2D translation( const XYZ& d ) { return Affine2D( 1, 0, 0, 1, d.x, d.y ); }
+
+   constexpr XYZ operator*( const XYZ& p ) const { return XYZ( m00 * p.x + m01 * p.y + tx, m10 * p.x + m11 * p.y + ty, p.z ); }
+   // without the translation, for differences of points
+   constexpr XYZ linear( const XYZ& d ) const { return XYZ( m00 * d.x + m01 * d.y, m10 * d.x + m11 * d.y, d.z ); }
+   constexpr Affine2D operator*( const Affine2D& rhs ) const
+   {
+      return Affine2D( m00 * rhs.m00 + m01 * rhs.m10, m00 * rhs.m01 + m01 * rhs.m11,
+                       m10 * rhs.m00 + m11 * rhs.m10, m10 * rhs.m01 + m11 * rhs.m11,
+                       m00 * rhs.tx + m01 * rhs.ty + tx, m10 * rhs.tx + m11 * rhs.ty + ty );
+   }
+   constexpr double det() const { return m00 * m11 - m01 * m10; }
+   constexpr Affine2D inverted() const
+   {
+      return Affine2D( m11 / det(), -m01 / det(), -m10 / det(), m00 / det(),
+                       ( m01 * ty - m11 * tx ) / det(), ( m10 * tx - m00 * ty ) / det() );
+   }
+
+public:
+   double m00, m01, m10, m11;
+   double tx, ty;
+};
+
+// Basis u, v of a 2D lattice together with the inverse basis, so converting a point to lattice
+// coordinates or wrapping it into the fundamental parallelogram takes a few multiplications.
+class CORE_API Lattice2D
+{
+public:
+   constexpr Lattice2D() : Lattice2D( XYZ( 1, 0, 0 ), XYZ( 0, 1, 0 ) ) {}
+   constexpr Lattice2D( const XYZ& u, const XYZ& v ) : _ToCartesian( u.x, v.x, u.y, v.y, 0, 0 ), _ToLattice( _ToCartesian.inverted() ) {}
+
+   constexpr XYZ u() const { return XYZ( _ToCartesian.m00, _ToCartesian.m10, 0 ); }
+   constexpr XYZ v() const { return XYZ( _ToCartesian.m01, _ToCartesian.m11, 0 ); }
+   // ( a, b ) with p = u * a + v * b, z kept
+   constexpr XYZ toLattice( const XYZ& p ) const { return _ToLattice * p; }
+   constexpr XYZ toCartesian( const XYZ& ab ) const { return _ToCartesian * ab; }
+   // p shifted by whole lattice vectors into the parallelogram spanned by u and v
+   XYZ wrap( const XYZ& p ) const
+   {
+      XYZ ab = toLattice( p );
+      return p - _ToCartesian.linear( XYZ( floor( ab.x ), floor( ab.y ), 0 ) );
+   }
+
+   // Lagrange-Gauss reduction: a basis of the same lattice where u is a shortest nonzero vector and v a shortest one
+   // independent of it, which makes the parallelogram as wide as possible in both directions. toOriginal maps
+   // lattice coordinates in the reduced basis to coordinates in this one; its entries are integers.
+   Lattice2D reduced( Affine2D& toOriginal ) const;
+
+private:
+   Affine2D _ToCartesian;
+   Affine2D _ToLattice;
+};
+
 class Perm
 {
 public:
@@ -0,0 +1,200 @@
+#include "Delauney.h"
+#include "delaunator.hpp"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+std::vector<std::vector<int>> delauney( const std::vector<XYZ>& v )
+{
+   ScopedTimer timer( "delauney" );
+   std::vector<double> flattenedCoords;
+   for ( const XYZ& p : v )
+   {
+      flattenedCoords.push_back( p.x );
+      flattenedCoords.push_back( p.y );
+   }  
+
+   delaunator::Delaunator delaunator( flattenedCoords );
+
+   std::vector<std::vector<int>> ret;
+   for ( int i = 0; i < (int)delaunator.triangles.size(); i += 3 )
+      ret.push_back( { (int)delaunator.triangles[i+0], (int)delaunator.triangles[i+1], (int)delaunator.triangles[i+2] } );
+ 
+   return ret;
+}
+
+namespace
+{
+   class GhostRef
+   {
+   public:
+      int _Index;
+      Sector _Sector;
+   };
+}
+
+std::vector<PeriodicTriangle> periodicDelauney( const PeriodicVertices& vertices )
+{
+   ScopedTimer timer( "periodicDelauney" );
+   std::vector<PeriodicTriangle> ret;
+   int n = (int) vertices._Vertices.size();
+   // a skewed cell needs images from far along its long diagonal, the reduced one of the same lattice doesn't
+   Affine2D toOriginal;
+   Lattice2D lattice = Lattice2D( vertices._U, vertices._V ).reduced( toOriginal );
+   XYZ u = lattice.u();
+   XYZ v = lattice.v();
+   double det = u.x * v.y - u.y * v.x;
+   if ( n == 0 || det == 0 )
+      return ret;
+
+   // lattice coordinates and the length of their gradients, i.e. how far they change per unit of distance
+   auto toLattice = [&]( const XYZ& p, double& a, double& b )
+   {
+      a = ( p.x * v.y - p.y * v.x ) / det;
+      b = ( u.x * p.y - u.y * p.x ) / det;
+   };
+   auto cellPos = [&]( const Sector& s ) { return u * s.x + v * s.y; };
+   auto toOriginalSector = [&]( const Sector& s )
+   {
+      XYZ ab = toOriginal.linear( XYZ( s.x, s.y, 0 ) );
+      return Sector { (int) lround( ab.x ), (int) lround( ab.y ) };
+   };
+   double gradA = v.len() / fabs( det );
+   double gradB = u.len() / fabs( det );
+   // A kept triangle's circumcircle holds no image of its anchor vertex, so its radius is at most the lattice's
+   // covering radius, which is at most ( |u| + |v| ) / 2. The anchor lies on the circle and in the fundamental
+   // domain, so these margins cover the whole circle.
+   double maxMarginA = ( u.len() + v.len() ) * gradA;
+   double maxMarginB = ( u.len() + v.len() ) * gradB;
+
+   // wrap every vertex into the fundamental domain; vertex i sits at wrapped[i] + cellPos( shift[i] )
+   std::vector<XYZ> wrapped( n );
+   std::vector<double> wrappedA( n ), wrappedB( n );
+   std::vector<Sector> shift( n );
+   for ( int i = 0; i < n; i++ )
+   {
+      const XYZ& p = vertices._Vertices[i]._Pos;
+      double a, b;
+      toLattice( p, a, b );
+      shift[i] = Sector { (int) floor( a ), (int) floor( b ) };
+      wrapped[i] = p - cellPos( shift[i] );
+      wrappedA[i] = a - shift[i].x;
+      wrappedB[i] = b - shift[i].y;
+   }
+
+   std::vector<double> coords;
+   std::vector<GhostRef> refs;
+   for ( double margin = 2 * sqrt( fabs( det ) / n ); ; margin *= 2 )
+   {
+      double marginA = std::min( margin * gradA, maxMarginA );
+      double marginB = std::min( margin * gradB, maxMarginB );
+      // the coverage test can only fail here through rounding, so the triangles are kept then
+      bool lastTry = marginA == maxMarginA && marginB == maxMarginB;
+
+      coords.clear();
+      refs.clear();
+      int numA = (int) ceil( marginA );
+      int numB = (int) ceil( marginB );
+      for ( int sy = -numB; sy <= numB; sy++ )
+      for ( int sx = -numA; sx <= numA; sx++ )
+      for ( int i = 0; i < n; i++ )
+      {
+         double a = wrappedA[i] + sx;
+         double b = wrappedB[i] + sy;
+         if ( a < -marginA || a >= 1 + marginA || b < -marginB || b >= 1 + marginB )
+            continue;
+         XYZ p = wrapped[i] + cellPos( Sector { sx, sy } );
+         coords.push_back( p.x );
+         coords.push_back( p.y );
+         refs.push_back( GhostRef { i, Sector { sx, sy } } );
+      }
+      // the largest margins are at least a cell wide, which gives every vertex 9 images
+      if ( refs.size() < 3 )
+         continue;
+
+      delaunator::Delaunator delaunator( coords );
+
+      ret.clear();
+      bool covered = true;
+      for ( size_t t = 0; t < delaunator.triangles.size(); t += 3 )
+      {
+         const GhostRef* corner[3];
+         for ( int k = 0; k < 3; k++ )
+            corner[k] = &refs[delaunator.triangles[t + k]];
+
+         // every translate of a periodic triangle is in here; keep the one whose lowest vertex
+         // (ties broken by sector) is the image in the fundamental domain
+         const GhostRef* anchor = corner[0];
+         for ( int k = 1; k < 3; k++ )
+         {
+            const GhostRef* c = corner[k];
+            if ( c->_Index < anchor->_Index
+              || ( c->_Index == anchor->_Index && ( c->_Sector.y < anchor->_Sector.y || ( c->_Sector.y == anchor->_Sector.y && c->_Sector.x < anchor->_Sector.x ) ) ) )
+               anchor = c;
+         }
+         if ( !( anchor->_Sector == Sector { 0, 0 } ) )
+            continue;
+
+         // only valid if no missing image could fall into the circumcircle
+         const double* p0 = &coords[2 * delaunator.triangles[t + 0]];
+         const double* p1 = &coords[2 * delaunator.triangles[t + 1]];
+         const double* p2 = &coords[2 * delaunator.triangles[t + 2]];
+         double bx = p1[0] - p0[0], by = p1[1] - p0[1];
+         double cx = p2[0] - p0[0], cy = p2[1] - p0[1];
+         double d = 2 * ( bx * cy - by * cx );
+         double b2 = bx * bx + by * by;
+         double c2 = cx * cx + cy * cy;
+         XYZ center( p0[0] + ( cy * b2 - by * c2 ) / d, p0[1] + ( bx * c2 - cx * b2 ) / d, 0 );
+         double radius = center.dist( XYZ( p0[0], p0[1], 0 ) );
+         double a, b;
+         toLattice( center, a, b );
+         if ( !lastTry && !( a - radius * gradA >= -marginA && a + radius * gradA <= 1 + marginA
+                          && b - radius * gradB >= -marginB && b + radius * gradB <= 1 + marginB ) )
+         {
+            covered = false;
+            break;
+         }
+
+         // delaunator's triangles are clockwise with y pointing up
+         PeriodicTriangle triangle;
+         for ( int k = 0; k < 3; k++ )
+         {
+            const GhostRef* c = corner[( 3 - k ) % 3];
+            triangle._Index[k] = c->_Index;
+            triangle._Sector[k] = toOriginalSector( c->_Sector - shift[c->_Index] );
+         }
+         ret.push_back( triangle );
+      }
+      // a triangle with corners beyond the margin is missing without any kept circle showing it, but the periodic
+      // triangulation of n vertices has 2n triangles
+      if ( covered && ( (int) ret.size() == 2 * n || lastTry ) )
+         return ret;
+   }
+}
+
+PeriodicAdjacency periodicAdjacency( const std::vector<PeriodicTriangle>& triangles, int numVertices )
+{
+   PeriodicAdjacency ret;
+   ret._Start.assign( numVertices + 1, 0 );
+   for ( const PeriodicTriangle& tri : triangles )
+      for ( int k = 0; k < 3; k++ )
+         ret._Start[tri._Index[k] + 1]++;
+   for ( int i = 0; i < numVertices; i++ )
+      ret._Start[i + 1] += ret._Start[i];
+
+   ret._Neighbor.resize( ret._Start[numVertices] );
+   ret._Offset.resize( ret._Start[numVertices] );
+   std::vector<int> fill( ret._Start.begin(), ret._Start.end() - 1 );
+   for ( const PeriodicTriangle& tri : triangles )
+   {
+      for ( int k = 0; k < 3; k++ )
+      {
+         int l = ( k + 1 ) % 3;
+         int slot = fill[tri._Index[k]]++;
+         ret._Neighbor[slot] = tri._Index[l];
+         ret._Offset[slot] = tri._Sector[l] - tri._Sector[k];
+      }
+   }
+   return ret;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "DataTypes.h"
+#include "Simulation.h"
+#include <vector>
+
+
+std::vector<std::vector<int>> delauney( const std::vector<XYZ>& v );
+
+// triangle of the periodic triangulation: corner k is vertex _Index[k] shifted into sector _Sector[k],
+// corners in counter-clockwise order
+class PeriodicTriangle
+{
+public:
+   int _Index[3];
+   Sector _Sector[3];
+};
+
+// Delaunay triangulation of the infinite periodic point set, one triangle per lattice translation class, 2n for
+// n vertices. Only the images within a margin around the fundamental domain of the reduced basis get triangulated;
+// the margin grows until every returned triangle's circumcircle lies inside the covered area, so the result is
+// exact. The covering radius of the lattice bounds the margin, however skewed the cell or few the vertices.
+// Empty without vertices or when u and v are parallel.
+std::vector<PeriodicTriangle> periodicDelauney( const PeriodicVertices& vertices );
+
+// neighbours of every vertex in compressed sparse row form: vertex i is adjacent to _Neighbor[k] shifted by
+// _Offset[k] (relative to i's own sector) for k in [_Start[i], _Start[i+1])
+class PeriodicAdjacency
+{
+public:
+   std::vector<int> _Start;
+   std::vector<int> _Neighbor;
+   std::vector<Sector> _Offset;
+};
+
+// every edge of the periodic triangulation is a half-edge in exactly one triangle in each direction,
+// so the half-edges leaving a vertex are its neighbours without duplicates
+PeriodicAdjacency periodicAdjacency( const std::vector<PeriodicTriangle>& triangles, int numVertices );
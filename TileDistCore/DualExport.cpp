@@ -0,0 +1,275 @@
+#include "DualExport.h"
+#include "Simulation.h"
+#include "Delauney.h"
+#include "JsonWriter.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <tuple>
+
+namespace
+{
+   // finds the output index of a vertex image without a map entry per image:
+   // one slot per vertex and sector of the bounding box of the exported sectors
+   class ImageIndex
+   {
+   public:
+      ImageIndex( const std::vector<VertexPtr>& images, int numVertices )
+         : _NumVertices( numVertices )
+      {
+         if ( images.empty() )
+            return;
+         _Min = _Max = images[0]._Sector;
+         for ( const VertexPtr& a : images )
+         {
+            _Min = Sector { std::min( _Min.x, a._Sector.x ), std::min( _Min.y, a._Sector.y ) };
+            _Max = Sector { std::max( _Max.x, a._Sector.x ), std::max( _Max.y, a._Sector.y ) };
+         }
+         _Index.assign( (size_t) ( _Max.x - _Min.x + 1 ) * ( _Max.y - _Min.y + 1 ) * numVertices, -1 );
+         for ( int i = 0; i < (int) images.size(); i++ )
+            _Index[slot( images[i].rawIndex(), images[i]._Sector )] = i;
+      }
+
+      int find( int index, const Sector& sector ) const
+      {
+         if ( _Index.empty() || sector.x < _Min.x || sector.x > _Max.x || sector.y < _Min.y || sector.y > _Max.y )
+            return -1;
+         return _Index[slot( index, sector )];
+      }
+
+   private:
+      size_t slot( int index, const Sector& sector ) const
+      {
+         return ( (size_t) ( sector.y - _Min.y ) * ( _Max.x - _Min.x + 1 ) + ( sector.x - _Min.x ) ) * _NumVertices + index;
+      }
+
+   private:
+      int _NumVertices;
+      Sector _Min;
+      Sector _Max;
+      std::vector<int> _Index;
+   };
+
+   void writeVector( const XYZ& p, JsonWriter& writer )
+   {
+      writer.beginArray();
+      writer.value( p.x );
+      writer.value( p.y );
+      writer.value( p.z );
+      writer.endArray();
+   }
+
+   bool writeFile( const std::string& filename, const std::function<void( JsonWriter& )>& write )
+   {
+      FILE* f = fopen( filename.c_str(), "wb" );
+      if ( !f )
+         return false;
+      bool ok;
+      {
+         JsonWriter writer( f );
+         write( writer );
+         writer.end();
+         ok = writer.flush();
+      }
+      return fclose( f ) == 0 && ok;
+   }
+
+   // { "colorPerm": [...], "group": "pN", "order": N, "transform": the rotation of element 1 as a Matrix4x4 }
+   void writeSymmetry( const Symmetry& symmetry, JsonWriter& writer )
+   {
+      if ( symmetry.isTrivial() )
+      {
+         writer.null();
+         return;
+      }
+      const Affine2D& r = symmetry.rotation( 1 );
+      Matrix4x4 transform( r.m00, r.m01, 0, r.tx,
+                           r.m10, r.m11, 0, r.ty,
+                           0, 0, 1, 0,
+                           0, 0, 0, 1 );
+      writer.beginObject();
+      writer.key( "colorPerm" );
+      writer.beginArray();
+      for ( int c : symmetry.colorPerm().v )
+         writer.value( c );
+      writer.endArray();
+      writer.key( "group" );
+      writer.value( "p" + std::to_string( symmetry.order() ) );
+      writer.key( "order" );
+      writer.value( symmetry.order() );
+      writer.key( "transform" );
+      // columns, as Matrix4x4::toJson() writes them
+      writer.beginArray();
+      for ( const XYZW& column : transform.m )
+      {
+         writer.beginArray();
+         writer.value( column.x );
+         writer.value( column.y );
+         writer.value( column.z );
+         writer.value( column.w );
+         writer.endArray();
+      }
+      writer.endArray();
+      writer.endObject();
+   }
+}
+
+void writeDual( const PeriodicVertices& periodicVertices, double R, JsonWriter& writer, const Symmetry& symmetry )
+{
+   ScopedTimer timer( "exportImages" );
+   std::vector<VertexPtr> vertices = periodicVertices.verticesInRange( R );
+   // ties are broken by vertex and sector so that the numbering doesn't depend on the enumeration order
+   std::sort( vertices.begin(), vertices.end(), []( const VertexPtr& a, const VertexPtr& b )
+   {
+      double a2 = a.pos().len2();
+      double b2 = b.pos().len2();
+      if ( a2 != b2 )
+         return a2 < b2;
+      return std::make_tuple( a.rawIndex(), a._Sector.y, a._Sector.x ) < std::make_tuple( b.rawIndex(), b._Sector.y, b._Sector.x );
+   } );
+   int numValidVertices;
+   for ( numValidVertices = 0; numValidVertices < (int) vertices.size(); numValidVertices++ )
+      if ( vertices[numValidVertices].pos().len2() >= R*R )
+         break;
+   vertices.resize( numValidVertices );
+
+   timer.next( "exportAdjacency" );
+   PeriodicAdjacency adjacency = periodicAdjacency( periodicDelauney( periodicVertices ), (int) periodicVertices._Vertices.size() );
+
+   timer.next( "exportWrite" );
+   ImageIndex imageIndex( vertices, (int) periodicVertices._Vertices.size() );
+
+   // members in sorted order, as Json::serialize() writes them
+   writer.beginObject();
+   writer.key( "shape" );
+   writer.beginObject();
+   writer.key( "type" );
+   writer.value( "plane" );
+   writer.endObject();
+   writer.key( "symmetry" );
+   writeSymmetry( symmetry, writer );
+   writer.key( "vertices" );
+   writer.beginArray();
+   std::vector<int> neighbors;
+   for ( int i = 0; i < numValidVertices; i++ )
+   {
+      const VertexPtr& a = vertices[i];
+      neighbors.clear();
+      for ( int k = adjacency._Start[a.rawIndex()]; k < adjacency._Start[a.rawIndex() + 1]; k++ )
+      {
+         int j = imageIndex.find( adjacency._Neighbor[k], a._Sector + adjacency._Offset[k] );
+         if ( j >= 0 )
+            neighbors.push_back( j );
+      }
+      std::sort( neighbors.begin(), neighbors.end() );
+
+      XYZ pos = a.pos();
+      writer.beginObject();
+      writer.key( "color" );
+      writer.value( a.color() );
+      writer.key( "index" );
+      writer.value( i );
+      writer.key( "neighbors" );
+      writer.beginArray();
+      for ( int j : neighbors )
+      {
+         writer.beginObject();
+         writer.key( "index" );
+         writer.value( j );
+         writer.key( "sector" );
+         writer.value( 0 );
+         writer.endObject();
+      }
+      writer.endArray();
+      writer.key( "pos" );
+      writeVector( pos, writer );
+      writer.endObject();
+   }
+   writer.endArray();
+   writer.endObject();
+}
+
+bool exportAsDual( const PeriodicVertices& vertices, double R, const std::string& filename, const Symmetry& symmetry )
+{
+   return writeFile( filename, [&]( JsonWriter& writer ) { writeDual( vertices, R, writer, symmetry ); } );
+}
+
+void writePeriodicDual( const PeriodicVertices& periodicVertices, JsonWriter& writer, const Symmetry& symmetry )
+{
+   ScopedTimer timer( "exportAdjacency" );
+   int numVertices = (int) periodicVertices._Vertices.size();
+   PeriodicAdjacency adjacency = periodicAdjacency( periodicDelauney( periodicVertices ), numVertices );
+
+   timer.next( "exportWrite" );
+   // vertices are written wrapped into the fundamental domain, so the offsets change by the sectors they came from
+   Lattice2D lattice( periodicVertices._U, periodicVertices._V );
+   std::vector<Sector> home( numVertices );
+   for ( int i = 0; i < numVertices; i++ )
+   {
+      XYZ ab = lattice.toLattice( periodicVertices._Vertices[i]._Pos );
+      home[i] = Sector { (int) floor( ab.x ), (int) floor( ab.y ) };
+   }
+
+   // members in sorted order, as Json::serialize() writes them
+   writer.beginObject();
+   writer.key( "shape" );
+   writer.beginObject();
+   writer.key( "type" );
+   writer.value( "periodic" );
+   writer.key( "u" );
+   writeVector( periodicVertices._U, writer );
+   writer.key( "v" );
+   writeVector( periodicVertices._V, writer );
+   writer.endObject();
+   writer.key( "symmetry" );
+   writeSymmetry( symmetry, writer );
+   writer.key( "vertices" );
+   writer.beginArray();
+   std::vector<std::tuple<int, int, int>> neighbors;
+   for ( int i = 0; i < numVertices; i++ )
+   {
+      const Vertex& a = periodicVertices._Vertices[i];
+      neighbors.clear();
+      for ( int k = adjacency._Start[i]; k < adjacency._Start[i + 1]; k++ )
+      {
+         int j = adjacency._Neighbor[k];
+         Sector offset = adjacency._Offset[k] + home[j] - home[i];
+         neighbors.emplace_back( j, offset.y, offset.x );
+      }
+      std::sort( neighbors.begin(), neighbors.end() );
+
+      writer.beginObject();
+      writer.key( "color" );
+      writer.value( a._Color );
+      writer.key( "index" );
+      writer.value( i );
+      writer.key( "neighbors" );
+      writer.beginArray();
+      for ( const std::tuple<int, int, int>& neighbor : neighbors )
+      {
+         writer.beginObject();
+         writer.key( "index" );
+         writer.value( std::get<0>( neighbor ) );
+         writer.key( "offset" );
+         writer.beginArray();
+         writer.value( std::get<2>( neighbor ) );
+         writer.value( std::get<1>( neighbor ) );
+         writer.endArray();
+         writer.endObject();
+      }
+      writer.endArray();
+      writer.key( "pos" );
+      writeVector( periodicVertices.pos( a._Pos, -home[i] ), writer );
+      writer.endObject();
+   }
+   writer.endArray();
+   writer.endObject();
+}
+
+bool exportAsPeriodicDual( const PeriodicVertices& vertices, const std::string& filename, const Symmetry& symmetry )
+{
+   return writeFile( filename, [&]( JsonWriter& writer ) { writePeriodicDual( vertices, writer, symmetry ); } );
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "Symmetry.h"
+
+#include <string>
+
+class JsonWriter;
+class PeriodicVertices;
+
+// Graph of all vertex images within distance R of the origin, connected by the Delaunay triangulation. vertices
+// is the whole pattern, e.g. Simulation::images(); symmetry is only recorded, null for p1.
+void writeDual( const PeriodicVertices& vertices, double R, JsonWriter& writer, const Symmetry& symmetry = Symmetry() );
+bool exportAsDual( const PeriodicVertices& vertices, double R, const std::string& filename, const Symmetry& symmetry = Symmetry() );
+
+// Only the vertices of the fundamental domain, with the lattice in "shape": { "type": "periodic", "u", "v" }.
+// A neighbour is { "index", "offset": [a, b] }, the image of vertex index moved by a*u + b*v relative to the
+// vertex listing it. Size and time are linear in the number of vertices, whatever radius the reader expands to.
+void writePeriodicDual( const PeriodicVertices& vertices, JsonWriter& writer, const Symmetry& symmetry = Symmetry() );
+bool exportAsPeriodicDual( const PeriodicVertices& vertices, const std::string& filename, const Symmetry& symmetry = Symmetry() );
@@ -0,0 +1,367 @@
+#include "DualImport.h"
+#include "MappedFile.h"
+
+#include <charconv>
+#include <climits>
+#include <cmath>
+#include <string_view>
+#include <unordered_map>
+
+namespace
+{
+   class ParseError
+   {
+   public:
+      const char* _Pos;
+      std::string _Message;
+   };
+
+   // pull parser for exactly the parts of the .dual schema that end up in a DualGraph
+   class DualParser
+   {
+   public:
+      DualParser( const char* begin, const char* end, DualGraph& graph )
+         : _Begin( begin ), _P( begin ), _End( end ), _Graph( graph )
+      {
+      }
+
+      void parse()
+      {
+         expect( '{' );
+         forEachMember( [&]( std::string_view key )
+         {
+            if ( key == "shape" )
+               parseShape();
+            else if ( key == "vertices" )
+               parseVertices();
+            else
+               skipValue();
+         } );
+         skipWhitespace();
+         if ( _P != _End )
+            fail( "unexpected data after the document" );
+      }
+
+      size_t offset( const char* p ) const { return p - _Begin; }
+      const std::vector<int>& fileIndex() const { return _FileIndex; }
+
+   private:
+      void parseShape()
+      {
+         expect( '{' );
+         forEachMember( [&]( std::string_view key )
+         {
+            if ( key == "type" )
+               _Graph._Periodic = parseString() == "periodic";
+            else if ( key == "u" )
+               _Graph._U = parseVector();
+            else if ( key == "v" )
+               _Graph._V = parseVector();
+            else
+               skipValue();
+         } );
+      }
+
+      // up to three coordinates, missing ones are 0
+      XYZ parseVector()
+      {
+         XYZ p;
+         double* coords[3] = { &p.x, &p.y, &p.z };
+         int n = 0;
+         expect( '[' );
+         forEachElement( [&]
+         {
+            double x = parseDouble();
+            if ( n < 3 )
+               *coords[n++] = x;
+         } );
+         return p;
+      }
+
+      void parseVertices()
+      {
+         _Graph._Start.push_back( 0 );
+         expect( '[' );
+         forEachElement( [&]
+         {
+            Vertex a { (int) _Graph._Vertices.size(), 0, XYZ() };
+            int fileIndex = a._Index;
+            expect( '{' );
+            forEachMember( [&]( std::string_view key )
+            {
+               if ( key == "color" )
+                  a._Color = parseInt();
+               else if ( key == "index" )
+                  fileIndex = parseInt();
+               else if ( key == "pos" )
+                  a._Pos = parseVector();
+               else if ( key == "neighbors" )
+                  parseNeighbors();
+               else
+                  skipValue();
+            } );
+            _Graph._Vertices.push_back( a );
+            _FileIndex.push_back( fileIndex );
+            _Graph._Start.push_back( (int) _Graph._Neighbor.size() );
+         } );
+      }
+
+      void parseNeighbors()
+      {
+         expect( '[' );
+         forEachElement( [&]
+         {
+            int index = -1;
+            int sector = 0;
+            Sector offset { 0, 0 };
+            expect( '{' );
+            forEachMember( [&]( std::string_view key )
+            {
+               if ( key == "index" )
+                  index = parseInt();
+               else if ( key == "sector" )
+                  sector = parseInt();
+               else if ( key == "offset" )
+               {
+                  int* coords[2] = { &offset.x, &offset.y };
+                  int n = 0;
+                  expect( '[' );
+                  forEachElement( [&]
+                  {
+                     int x = parseInt();
+                     if ( n < 2 )
+                        *coords[n++] = x;
+                  } );
+               }
+               else
+                  skipValue();
+            } );
+            _Graph._Neighbor.push_back( index );
+            _Graph._NeighborSector.push_back( sector );
+            _Graph._NeighborOffset.push_back( offset );
+         } );
+      }
+
+      // after the opening brace: calls f( key ) with the parser positioned on each member's value
+      template<typename F> void forEachMember( F f )
+      {
+         skipWhitespace();
+         if ( peek() == '}' )
+         {
+            _P++;
+            return;
+         }
+         for ( ;; )
+         {
+            std::string_view key = parseString();
+            expect( ':' );
+            f( key );
+            skipWhitespace();
+            char c = next();
+            if ( c == '}' )
+               return;
+            if ( c != ',' )
+               fail( "expected ',' or '}'" );
+         }
+      }
+
+      // after the opening bracket: calls f() with the parser positioned on each element
+      template<typename F> void forEachElement( F f )
+      {
+         skipWhitespace();
+         if ( peek() == ']' )
+         {
+            _P++;
+            return;
+         }
+         for ( ;; )
+         {
+            f();
+            skipWhitespace();
+            char c = next();
+            if ( c == ']' )
+               return;
+            if ( c != ',' )
+               fail( "expected ',' or ']'" );
+         }
+      }
+
+      void skipValue()
+      {
+         skipWhitespace();
+         switch ( peek() )
+         {
+         case '{': _P++; forEachMember( [&]( std::string_view ) { skipValue(); } ); break;
+         case '[': _P++; forEachElement( [&] { skipValue(); } ); break;
+         case '"': parseString(); break;
+         case 't': literal( "true" ); break;
+         case 'f': literal( "false" ); break;
+         case 'n': literal( "null" ); break;
+         default: parseDouble(); break;
+         }
+      }
+
+      // the raw characters between the quotes; escapes are skipped over but left as they are
+      std::string_view parseString()
+      {
+         expect( '"' );
+         const char* begin = _P;
+         while ( _P < _End && *_P != '"' )
+            _P += *_P == '\\' ? 2 : 1;
+         if ( _P >= _End )
+            fail( "unterminated string" );
+         return std::string_view( begin, _P++ - begin );
+      }
+
+      double parseDouble()
+      {
+         skipWhitespace();
+         double x;
+         std::from_chars_result result = std::from_chars( _P, _End, x );
+         if ( result.ec != std::errc() )
+            fail( "expected a number" );
+         _P = result.ptr;
+         return x;
+      }
+
+      int parseInt()
+      {
+         skipWhitespace();
+         int x;
+         std::from_chars_result result = std::from_chars( _P, _End, x );
+         // older exports wrote large indices as 1e+05
+         if ( result.ec == std::errc() && ( result.ptr == _End || ( *result.ptr != '.' && *result.ptr != 'e' && *result.ptr != 'E' ) ) )
+         {
+            _P = result.ptr;
+            return x;
+         }
+         const char* start = _P;
+         double d = parseDouble();
+         if ( !( d >= INT_MIN && d <= INT_MAX ) || d != floor( d ) )
+         {
+            _P = start;
+            fail( "expected an integer" );
+         }
+         return (int) d;
+      }
+
+      void literal( const char* word )
+      {
+         for ( const char* c = word; *c; c++ )
+            if ( next() != *c )
+               fail( std::string( "expected " ) + word );
+      }
+
+      void expect( char c )
+      {
+         skipWhitespace();
+         if ( next() != c )
+            fail( std::string( "expected '" ) + c + "'" );
+      }
+
+      void skipWhitespace()
+      {
+         while ( _P < _End && ( *_P == ' ' || *_P == '\n' || *_P == '\r' || *_P == '\t' ) )
+            _P++;
+      }
+
+      char peek() const { return _P < _End ? *_P : 0; }
+      char next()
+      {
+         if ( _P >= _End )
+            fail( "unexpected end of file" );
+         return *_P++;
+      }
+
+      [[noreturn]] void fail( const std::string& message ) const { throw ParseError { _P, message }; }
+
+   private:
+      const char* _Begin;
+      const char* _P;
+      const char* _End;
+      DualGraph& _Graph;
+      // the "index" each vertex was given in the file, normally its position
+      std::vector<int> _FileIndex;
+   };
+}
+
+bool importDual( const std::string& filename, DualGraph& graph, std::string& error )
+{
+   MappedFile file;
+   if ( !file.open( filename, error ) )
+      return false;
+
+   graph = DualGraph();
+   DualParser parser( file.data(), file.data() + file.size(), graph );
+   try
+   {
+      parser.parse();
+   }
+   catch ( const ParseError& e )
+   {
+      error = filename + ": " + e._Message + " at byte " + std::to_string( parser.offset( e._Pos ) );
+      graph = DualGraph();
+      return false;
+   }
+
+   // neighbours refer to the vertices' "index" fields, which only need a lookup if they aren't the positions
+   const std::vector<int>& fileIndex = parser.fileIndex();
+   std::unordered_map<int, int> position;
+   for ( int i = 0; i < (int) fileIndex.size() && position.empty(); i++ )
+   {
+      if ( fileIndex[i] != i )
+      {
+         for ( int j = 0; j < (int) fileIndex.size(); j++ )
+            position[fileIndex[j]] = j;
+      }
+   }
+
+   for ( int& neighbor : graph._Neighbor )
+   {
+      if ( !position.empty() )
+      {
+         auto it = position.find( neighbor );
+         neighbor = it == position.end() ? -1 : it->second;
+      }
+      if ( neighbor < 0 || neighbor >= (int) graph._Vertices.size() )
+      {
+         error = filename + ": a neighbour refers to a vertex that isn't in the file";
+         graph = DualGraph();
+         return false;
+      }
+   }
+   return true;
+}
+
+bool loadDual( const std::string& filename, Simulation& simulation, std::string& error )
+{
+   DualGraph graph;
+   if ( !importDual( filename, graph, error ) )
+      return false;
+   if ( !graph._Periodic )
+   {
+      error = filename + " is not a periodic export";
+      return false;
+   }
+   if ( graph._U.x * graph._V.y - graph._U.y * graph._V.x == 0 )
+   {
+      error = filename + ": the lattice vectors are parallel";
+      return false;
+   }
+   for ( const Vertex& a : graph._Vertices )
+   {
+      if ( a._Color < 0 )
+      {
+         error = filename + ": negative vertex colour";
+         return false;
+      }
+   }
+
+   // the file holds the whole pattern, which needn't have the simulation's symmetry
+   simulation._ClickedVertex = VertexPtr();
+   simulation._Vertices.swap( graph._Vertices );
+   simulation._Symmetry = Symmetry();
+   simulation._ClickedElement = 0;
+   simulation.setUV( graph._U, graph._V );
+   return true;
+}
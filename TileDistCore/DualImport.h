@@ -0,0 +1,30 @@
+#pragma once
+
+#include "Simulation.h"
+
+#include <string>
+#include <vector>
+
+// contents of a .dual file: vertex i of the file is _Vertices[i], its neighbours are
+// _Neighbor[_Start[i]] .. _Neighbor[_Start[i+1]-1] with the sectors given next to them
+class DualGraph
+{
+public:
+   std::vector<Vertex> _Vertices;
+   std::vector<int> _Start;
+   std::vector<int> _Neighbor;
+   std::vector<int> _NeighborSector;
+   // periodic exports: the vertices repeat on the lattice _U, _V and each neighbour is the image of
+   // _Neighbor[k] moved by _NeighborOffset[k] lattice vectors; all offsets are 0 for plain exports
+   bool _Periodic = false;
+   XYZ _U;
+   XYZ _V;
+   std::vector<Sector> _NeighborOffset;
+};
+
+// Reads a .dual file as written by exportAsDual() in one pass over a memory map, without building Json values.
+// Members the reader doesn't know are skipped, so files with extra fields load as well.
+bool importDual( const std::string& filename, DualGraph& graph, std::string& error );
+// Replaces the simulation's lattice and vertices with those of a periodic export, to continue from it. Plain
+// exports stop at their radius and can't be continued. The other settings stay as they are.
+bool loadDual( const std::string& filename, Simulation& simulation, std::string& error );
@@ -0,0 +1,99 @@
+#include "Ensemble.h"
+#include "StepScheduler.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <random>
+
+namespace
+{
+   // steps between two checks of the violation
+   const int CHECK_INTERVAL = 100;
+
+   // std::uniform_*_distribution differ between standard libraries, mt19937_64 itself does not
+   double uniform( std::mt19937_64& rng ) { return ( rng() >> 11 ) * ( 1. / 9007199254740992. ); }
+}
+
+std::vector<EnsembleRun> Ensemble::run( const Simulation& prototype )
+{
+   _Cancel = false;
+   std::vector<EnsembleRun> runs( std::max( 0, _Settings._NumRuns ) );
+   for ( int i = 0; i < (int) runs.size(); i++ )
+   {
+      runs[i]._Index = i;
+      runs[i]._Seed = _Settings._Seed + i;
+   }
+
+   // runs take very different times, so every thread keeps taking the next run instead of getting a fixed share
+   ThreadPool pool( _Settings._NumThreads );
+   std::atomic<int> nextRun { 0 };
+   pool.parallelFor( std::min( pool.numThreads(), (int) runs.size() ), 0, [&]( int, int )
+   {
+      for ( int i; ( i = nextRun++ ) < (int) runs.size(); )
+         runOne( prototype, runs[i] );
+   } );
+
+   std::stable_sort( runs.begin(), runs.end(), []( const EnsembleRun& a, const EnsembleRun& b )
+   {
+      if ( a._Violation != b._Violation )
+         return a._Violation < b._Violation;
+      return a._Energy < b._Energy;
+   } );
+   return runs;
+}
+
+void Ensemble::runOne( const Simulation& prototype, EnsembleRun& run )
+{
+   Simulation simulation;
+   simulation.setUV( prototype._U, prototype._V );
+   simulation._MinDistanceAllowed = prototype._MinDistanceAllowed;
+   simulation._MinDistanceAllowed_SameColor = prototype._MinDistanceAllowed_SameColor;
+   simulation._PairDistances = prototype._PairDistances;
+   simulation._Symmetry = prototype._Symmetry;
+   simulation._Tension = prototype._Tension;
+   simulation._Kernel = prototype._Kernel;
+   simulation._Method = prototype._Method;
+   simulation.setNumThreads( 1 );
+
+   std::mt19937_64 rng( run._Seed );
+   std::vector<int> colors;
+   for ( const Vertex& a : prototype._Vertices )
+      colors.push_back( a._Color );
+   for ( int i = (int) colors.size() - 1; i > 0; i-- )
+      std::swap( colors[i], colors[rng() % ( i + 1 )] );
+   for ( int color : colors )
+   {
+      double x = uniform( rng );
+      double y = uniform( rng );
+      simulation.addVertex( simulation._U * x + simulation._V * y, color );
+   }
+
+   StepScheduler scheduler;
+   for ( ;; )
+   {
+      run._Violation = simulation.maxOverlap();
+      run._Success = run._Violation <= _Settings._Tolerance;
+      if ( run._Success )
+      {
+         if ( _Settings._CancelOnSuccess )
+            _Cancel = true;
+         break;
+      }
+      if ( _Cancel )
+      {
+         run._Cancelled = true;
+         break;
+      }
+      if ( run._Steps >= _Settings._MaxSteps || scheduler.settled() )
+         break;
+      run._Steps += scheduler.run( simulation, StepScheduler::Clock::duration::max(), std::min( CHECK_INTERVAL, _Settings._MaxSteps - run._Steps ) );
+      run._Energy = scheduler.lastStats()._Energy;
+   }
+   run._Vertices = simulation._Vertices;
+}
+
+void Ensemble::apply( const EnsembleRun& run, Simulation& simulation )
+{
+   simulation._ClickedVertex = VertexPtr();
+   simulation._Vertices = run._Vertices;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Simulation.h"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+class EnsembleSettings
+{
+public:
+   int _NumRuns = 16;
+   // run i uses seed _Seed + i, so a single run can be repeated with _NumRuns = 1 and its own seed
+   uint64_t _Seed = 1;
+   int _MaxSteps = 20000;
+   // a run succeeds once no pair overlaps by more than this
+   double _Tolerance = 1e-3;
+   // stop the remaining runs as soon as one succeeds
+   bool _CancelOnSuccess = false;
+   // 0 means one per core
+   int _NumThreads = 0;
+};
+
+class EnsembleRun
+{
+public:
+   int _Index = 0;
+   uint64_t _Seed = 0;
+   int _Steps = 0;
+   // Simulation::maxOverlap() at the end of the run and the energy of its last step
+   double _Violation = 0;
+   double _Energy = 0;
+   bool _Success = false;
+   bool _Cancelled = false;
+   std::vector<Vertex> _Vertices;
+};
+
+// Runs many independent simulations from random initial positions and colourings, looking for one where
+// no minimum distance is violated. Every run starts from the prototype's lattice, distances, tension and kernel,
+// with its vertices placed uniformly in the fundamental domain and its colours shuffled. A run only depends on
+// its seed, except that it may be cut short by cancel() or _CancelOnSuccess.
+class Ensemble
+{
+public:
+   explicit Ensemble( const EnsembleSettings& settings ) : _Settings( settings ) {}
+
+   // returns the runs ranked by violation, best first
+   std::vector<EnsembleRun> run( const Simulation& prototype );
+   // may be called from any thread while run() is busy
+   void cancel() { _Cancel = true; }
+
+   // replaces simulation's vertices by the ones a run ended with
+   static void apply( const EnsembleRun& run, Simulation& simulation );
+
+private:
+   void runOne( const Simulation& prototype, EnsembleRun& run );
+
+private:
+   EnsembleSettings _Settings;
+   std::atomic<bool> _Cancel { false };
+};
@@ -0,0 +1,175 @@
+#include "Json.h"
+#include "JsonWriter.h"
+
+#include <algorithm>
+
+
+//void go()
+//{
+//   Json a( 5 );
+//   Json b( {{"hey", 5}, {"you", false}} );
+//   Json c( {{"hey", 5}, {"you", {"yesyou", 19}}} );
+//}
+
+namespace
+{
+   std::pmr::memory_resource* resourceOf( JsonArena* arena )
+   {
+      return arena ? arena->resource() : std::pmr::get_default_resource();
+   }
+
+   bool memberLess( const std::pair<std::string, Json>& member, const std::string& name ) { return member.first < name; }
+}
+
+Json::Json( Type type, JsonArena* arena )
+{
+   init( type, resourceOf( arena ) );
+}
+
+Json::Json( const Json& rhs )
+{
+   _Type = rhs._Type;
+   switch ( _Type )
+   {
+   case NONE:   break;
+   case OBJECT: new (&_Object) Object( rhs._Object.begin(), rhs._Object.end() ); break;
+   case ARRAY:  new (&_Array) Array( rhs._Array.begin(), rhs._Array.end() ); break;
+   case STRING: new (&_String) std::string( rhs._String ); break;
+   case NUMBER: _Number = rhs._Number; break;
+   case BOOL:   _Bool = rhs._Bool; break;
+   }
+}
+
+Json::Json( Json&& rhs ) noexcept
+{
+   moveFrom( rhs );
+}
+
+Json& Json::operator=( const Json& rhs )
+{
+   if ( this != &rhs )
+   {
+      // rhs may live inside this
+      Json copy( rhs );
+      clear();
+      moveFrom( copy );
+   }
+   return *this;
+}
+
+Json& Json::operator=( Json&& rhs ) noexcept
+{
+   if ( this != &rhs )
+   {
+      Json moved( std::move( rhs ) );
+      clear();
+      moveFrom( moved );
+   }
+   return *this;
+}
+
+void Json::init( Type type, std::pmr::memory_resource* resource )
+{
+   _Type = type;
+   switch ( type )
+   {
+   case NONE:   break;
+   case OBJECT: new (&_Object) Object( resource ); break;
+   case ARRAY:  new (&_Array) Array( resource ); break;
+   case STRING: new (&_String) std::string(); break;
+   case NUMBER: _Number = 0; break;
+   case BOOL:   _Bool = false; break;
+   }
+}
+
+void Json::moveFrom( Json& rhs )
+{
+   _Type = rhs._Type;
+   switch ( _Type )
+   {
+   case NONE:   break;
+   case OBJECT: new (&_Object) Object( std::move( rhs._Object ) ); break;
+   case ARRAY:  new (&_Array) Array( std::move( rhs._Array ) ); break;
+   case STRING: new (&_String) std::string( std::move( rhs._String ) ); break;
+   case NUMBER: _Number = rhs._Number; break;
+   case BOOL:   _Bool = rhs._Bool; break;
+   }
+}
+
+void Json::clear()
+{
+   switch ( _Type )
+   {
+   case OBJECT: _Object.~Object(); break;
+   case ARRAY:  _Array.~Array(); break;
+   case STRING: _String.~basic_string(); break;
+   default:     break;
+   }
+   _Type = NONE;
+}
+
+void Json::setType( Type type )
+{
+   if ( _Type == type )
+      return;
+   if ( _Type != NONE )
+      throw 777;
+   init( type, std::pmr::get_default_resource() );
+}
+
+const Json* Json::findMember( const std::string& name ) const
+{
+   if ( _Type != OBJECT )
+      return nullptr;
+   auto it = std::lower_bound( _Object.begin(), _Object.end(), name, memberLess );
+   return it != _Object.end() && it->first == name ? &it->second : nullptr;
+}
+
+Json& Json::operator[]( const std::string& name )
+{
+   setType( OBJECT );
+   auto it = std::lower_bound( _Object.begin(), _Object.end(), name, memberLess );
+   if ( it == _Object.end() || it->first != name )
+      it = _Object.emplace( it, name, Json() );
+   return it->second;
+}
+
+const Json& Json::operator[]( const std::string& name ) const
+{
+   const Json* member = findMember( name );
+   return member ? *member : emptyStatic();
+}
+
+std::string Json::serialize( bool compact ) const
+{
+   JsonWriter writer( compact );
+   write( writer );
+   writer.end();
+   return writer.str();
+}
+
+void Json::write( JsonWriter& writer ) const
+{
+   switch ( _Type )
+   {
+   case NONE:   writer.null(); break;
+   case BOOL:   writer.value( _Bool ); break;
+   case NUMBER: writer.value( _Number ); break;
+   case STRING: writer.value( _String ); break;
+   case ARRAY:
+      writer.beginArray();
+      for ( const Json& json : _Array )
+         json.write( writer );
+      writer.endArray();
+      break;
+   case OBJECT:
+      writer.beginObject();
+      for ( const auto& member : _Object )
+      {
+         writer.key( member.first );
+         member.second.write( writer );
+      }
+      writer.endObject();
+      break;
+   }
+}
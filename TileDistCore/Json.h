@@ -0,0 +1,124 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <memory_resource>
+#include <map>
+#include <cmath>
+#include <utility>
+
+class JsonWriter;
+
+// Memory for building large documents in one go: objects and arrays created on an arena keep their elements in
+// blocks that are all released together with the arena, so such values must not outlive it. Copies of them
+// go back to the heap; moves keep using the arena.
+class JsonArena
+{
+public:
+   std::pmr::memory_resource* resource() { return &_Resource; }
+
+private:
+   std::pmr::monotonic_buffer_resource _Resource;
+};
+
+// Holds exactly one of its types. Numbers, bools, null and short strings don't allocate; objects and arrays
+// allocate one block for their elements, from an arena if they were created on one.
+class Json
+{
+public:
+   enum Type { NONE, OBJECT, ARRAY, STRING, NUMBER, BOOL };
+   typedef std::pmr::vector<Json> Array;
+   // members sorted by name
+   typedef std::pmr::vector<std::pair<std::string, Json>> Object;
+
+public:
+   Json() { _Type = NONE; }
+   Json( double number ) { _Type = NUMBER; _Number = number; }
+   Json( int number ) { _Type = NUMBER; _Number = number; }
+   Json( const std::string& str ) { _Type = STRING; new (&_String) std::string( str ); }
+   Json( std::string&& str ) { _Type = STRING; new (&_String) std::string( std::move( str ) ); }
+   Json( const char* str ) { _Type = STRING; new (&_String) std::string( str ); }
+   template<typename T> Json( const std::vector<T>& array ) { _Type = ARRAY; new (&_Array) Array( array.begin(), array.end() ); }
+   Json( bool b ) { _Type = BOOL; _Bool = b; }
+   // empty object or array, on arena if given
+   explicit Json( Type type, JsonArena* arena = nullptr );
+
+   Json( const Json& rhs );
+   Json( Json&& rhs ) noexcept;
+   Json& operator=( const Json& rhs );
+   Json& operator=( Json&& rhs ) noexcept;
+   ~Json() { clear(); }
+
+   Type type() const { return _Type; }
+   const Array& toArray() const { return _Type == ARRAY ? _Array : emptyArray(); }
+   const Object& toMap() const { return _Type == OBJECT ? _Object : emptyObject(); }
+   const std::string& toString() const { return _Type == STRING ? _String : emptyString(); }
+   double toDouble() const { return _Type == NUMBER ? _Number : 0; }
+   int toInt() const { return lround( toDouble() ); }
+   bool toBool() const { return _Type == BOOL && _Bool; }
+
+   void push_back( const Json& json ) { setType( ARRAY ); _Array.push_back( json ); }
+   void push_back( Json&& json ) { setType( ARRAY ); _Array.push_back( std::move( json ) ); }
+   void reserve( int size ) { setType( ARRAY ); _Array.reserve( size ); }
+   Json& operator[]( const std::string& name );
+   const Json& operator[]( const std::string& name ) const;
+   Json& operator[]( int index ) { setType( ARRAY ); return _Array[index]; }
+   const Json& operator[]( int index ) const { checkType( ARRAY ); return _Array[index]; }
+   static const Json& emptyStatic() { static Json s_emptyStatic; return s_emptyStatic; }
+
+   bool hasMember( const std::string& name ) const { return findMember( name ) != nullptr; }
+
+   bool isString() const { return _Type == STRING; }
+   bool isObject() const { return _Type == OBJECT; }
+   bool operator==( const std::string& str ) const { return isString() && str == _String; }
+
+   // same layout as QJsonDocument::toJson()
+   std::string serialize( bool compact = false ) const;
+
+protected:
+   Json( const std::initializer_list<Json>& array ) { _Type = ARRAY; new (&_Array) Array( array.begin(), array.end() ); }
+   Json( const std::vector<Json>& array ) { _Type = ARRAY; new (&_Array) Array( array.begin(), array.end() ); }
+   Json( const std::map<std::string, Json>& obj ) { _Type = OBJECT; new (&_Object) Object( obj.begin(), obj.end() ); }
+
+private:
+   void write( JsonWriter& writer ) const;
+   void init( Type type, std::pmr::memory_resource* resource );
+   void moveFrom( Json& rhs );
+   void clear();
+   const Json* findMember( const std::string& name ) const;
+   void setType( Type type );
+   void checkType( Type type ) const { if ( type != _Type ) throw 777; }
+
+   static const Array& emptyArray() { static const Array s_empty; return s_empty; }
+   static const Object& emptyObject() { static const Object s_empty; return s_empty; }
+   static const std::string& emptyString() { static const std::string s_empty; return s_empty; }
+
+private:
+   Type _Type = NONE;
+   union
+   {
+      double      _Number;
+      bool        _Bool;
+      std::string _String;
+      Array       _Array;
+      Object      _Object;
+   };
+};
+
+class JsonObj : public Json
+{
+public:
+   JsonObj( const std::map<std::string, Json>& obj ) : Json( obj ) {}
+   JsonObj( const std::initializer_list<std::pair<std::string, Json>>& obj ) : Json( OBJECT ) {
+      for ( const auto& e : obj )
+         (*this)[e.first] = e.second;
+   }
+};
+
+class JsonArray : public Json
+{
+public:
+   JsonArray() : Json( ARRAY ) {}
+   JsonArray( const std::initializer_list<Json>& array ) : Json( array ) {}
+};
@@ -0,0 +1,172 @@
+#include "JsonWriter.h"
+
+#include <charconv>
+#include <cmath>
+
+namespace
+{
+   // bytes collected before they are passed on to the file
+   const size_t BLOCK_SIZE = 1 << 16;
+}
+
+JsonWriter::JsonWriter( bool compact )
+   : _Compact( compact )
+{
+}
+
+JsonWriter::JsonWriter( FILE* file, bool compact )
+   : _File( file ), _Compact( compact )
+{
+   _Buffer.reserve( 2 * BLOCK_SIZE );
+}
+
+void JsonWriter::newline()
+{
+   if ( _Compact )
+      return;
+   _Buffer += '\n';
+   _Buffer.append( 4 * _ItemCounts.size(), ' ' );
+}
+
+void JsonWriter::beginValue()
+{
+   if ( _AfterKey )
+   {
+      _AfterKey = false;
+      return;
+   }
+   if ( _ItemCounts.empty() )
+      return;
+   if ( _ItemCounts.back()++ > 0 )
+      _Buffer += ',';
+   newline();
+}
+
+void JsonWriter::beginContainer( char open )
+{
+   beginValue();
+   _Buffer += open;
+   _ItemCounts.push_back( 0 );
+}
+
+void JsonWriter::endContainer( char close )
+{
+   _ItemCounts.pop_back();
+   newline();
+   _Buffer += close;
+   flushIfFull();
+}
+
+void JsonWriter::beginObject() { beginContainer( '{' ); }
+void JsonWriter::endObject() { endContainer( '}' ); }
+void JsonWriter::beginArray() { beginContainer( '[' ); }
+void JsonWriter::endArray() { endContainer( ']' ); }
+
+void JsonWriter::key( const std::string& name )
+{
+   beginValue();
+   writeString( name );
+   _Buffer += _Compact ? ":" : ": ";
+   _AfterKey = true;
+}
+
+void JsonWriter::null()
+{
+   beginValue();
+   _Buffer += "null";
+}
+
+void JsonWriter::value( bool b )
+{
+   beginValue();
+   _Buffer += b ? "true" : "false";
+}
+
+void JsonWriter::value( int x )
+{
+   beginValue();
+   char buf[16];
+   std::to_chars_result result = std::to_chars( buf, buf + sizeof( buf ), x );
+   _Buffer.append( buf, result.ptr );
+}
+
+void JsonWriter::value( double x )
+{
+   if ( !std::isfinite( x ) )
+   {
+      null();
+      return;
+   }
+   beginValue();
+   char buf[32];
+   std::to_chars_result result;
+   // whole numbers as integers like QJsonDocument does, not as 1e+05
+   if ( x == floor( x ) && fabs( x ) < 1e15 )
+      result = std::to_chars( buf, buf + sizeof( buf ), (long long) x );
+   else
+      // without a format, to_chars gives the shortest representation that reads back to the same double
+      result = std::to_chars( buf, buf + sizeof( buf ), x );
+   _Buffer.append( buf, result.ptr );
+}
+
+void JsonWriter::value( const char* str )
+{
+   value( std::string( str ) );
+}
+
+void JsonWriter::value( const std::string& str )
+{
+   beginValue();
+   writeString( str );
+}
+
+void JsonWriter::writeString( const std::string& str )
+{
+   _Buffer += '"';
+   for ( char c : str )
+   {
+      switch ( c )
+      {
+      case '"':  _Buffer += "\\\""; break;
+      case '\\': _Buffer += "\\\\"; break;
+      case '\b': _Buffer += "\\b"; break;
+      case '\f': _Buffer += "\\f"; break;
+      case '\n': _Buffer += "\\n"; break;
+      case '\r': _Buffer += "\\r"; break;
+      case '\t': _Buffer += "\\t"; break;
+      default:
+         if ( (unsigned char) c < 0x20 )
+         {
+            char buf[8];
+            snprintf( buf, sizeof( buf ), "\\u%04x", (int) c );
+            _Buffer += buf;
+         }
+         else
+            _Buffer += c;
+      }
+   }
+   _Buffer += '"';
+}
+
+void JsonWriter::end()
+{
+   if ( !_Compact )
+      _Buffer += '\n';
+   flush();
+}
+
+void JsonWriter::flushIfFull()
+{
+   if ( _File && _Buffer.size() >= BLOCK_SIZE )
+      flush();
+}
+
+bool JsonWriter::flush()
+{
+   if ( !_File )
+      return true;
+   if ( !_Buffer.empty() && fwrite( _Buffer.data(), 1, _Buffer.size(), _File ) != _Buffer.size() )
+      _Failed = true;
+   _Buffer.clear();
+   return !_Failed;
+}
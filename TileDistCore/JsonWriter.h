@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Writes JSON piece by piece in the same layout as Json::serialize(), without building a Json tree.
+// Members have to be written in sorted order for the output to match Json::serialize() exactly.
+class JsonWriter
+{
+public:
+   // collects the output in memory, see str()
+   explicit JsonWriter( bool compact = false );
+   // passes the output on to file in large blocks
+   explicit JsonWriter( FILE* file, bool compact = false );
+   ~JsonWriter() { flush(); }
+   JsonWriter( const JsonWriter& ) = delete;
+   JsonWriter& operator=( const JsonWriter& ) = delete;
+
+   void beginObject();
+   void endObject();
+   void beginArray();
+   void endArray();
+   // the next value belongs to the member called name
+   void key( const std::string& name );
+
+   void null();
+   void value( bool b );
+   void value( int x );
+   void value( double x );
+   void value( const char* str );
+   void value( const std::string& str );
+
+   // ends the document with a newline unless compact
+   void end();
+   // false if anything could not be written to the file
+   bool flush();
+   const std::string& str() const { return _Buffer; }
+
+private:
+   void beginValue();
+   void beginContainer( char open );
+   void endContainer( char close );
+   void writeString( const std::string& str );
+   void newline();
+   void flushIfFull();
+
+private:
+   std::string _Buffer;
+   FILE* _File = nullptr;
+   bool _Compact;
+   bool _Failed = false;
+   bool _AfterKey = false;
+   // number of items written so far in each open container
+   std::vector<int> _ItemCounts;
+};
@@ -0,0 +1,110 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool MappedFile::open( const std::string& filename, std::string& error )
+{
+   close();
+   HANDLE file = CreateFileA( filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+   if ( file == INVALID_HANDLE_VALUE )
+   {
+      error = "cannot open " + filename;
+      return false;
+   }
+   _File = file;
+
+   LARGE_INTEGER size;
+   if ( !GetFileSizeEx( file, &size ) )
+   {
+      error = "cannot read the size of " + filename;
+      close();
+      return false;
+   }
+   _Size = (size_t) size.QuadPart;
+   if ( _Size == 0 )
+      return true;
+
+   _Mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+   if ( _Mapping )
+      _Data = (const char*) MapViewOfFile( _Mapping, FILE_MAP_READ, 0, 0, 0 );
+   if ( !_Data )
+   {
+      error = "cannot map " + filename;
+      close();
+      return false;
+   }
+   return true;
+}
+
+void MappedFile::close()
+{
+   if ( _Data )
+      UnmapViewOfFile( _Data );
+   if ( _Mapping )
+      CloseHandle( _Mapping );
+   if ( _File )
+      CloseHandle( _File );
+   _Data = nullptr;
+   _Size = 0;
+   _Mapping = nullptr;
+   _File = nullptr;
+}
+
+#else
+
+bool MappedFile::open( const std::string& filename, std::string& error )
+{
+   close();
+   _Fd = ::open( filename.c_str(), O_RDONLY );
+   if ( _Fd < 0 )
+   {
+      error = "cannot open " + filename;
+      return false;
+   }
+
+   struct stat st;
+   if ( fstat( _Fd, &st ) != 0 )
+   {
+      error = "cannot read the size of " + filename;
+      close();
+      return false;
+   }
+   _Size = (size_t) st.st_size;
+   if ( _Size == 0 )
+      return true;
+
+   void* data = mmap( nullptr, _Size, PROT_READ, MAP_PRIVATE, _Fd, 0 );
+   if ( data == MAP_FAILED )
+   {
+      error = "cannot map " + filename;
+      close();
+      return false;
+   }
+   _Data = (const char*) data;
+   madvise( data, _Size, MADV_SEQUENTIAL );
+   return true;
+}
+
+void MappedFile::close()
+{
+   if ( _Data )
+      munmap( (void*) _Data, _Size );
+   if ( _Fd >= 0 )
+      ::close( _Fd );
+   _Data = nullptr;
+   _Size = 0;
+   _Fd = -1;
+}
+
+#endif
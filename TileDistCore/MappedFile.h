@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory map of a whole file.
+class MappedFile
+{
+public:
+   MappedFile() {}
+   ~MappedFile() { close(); }
+   MappedFile( const MappedFile& ) = delete;
+   MappedFile& operator=( const MappedFile& ) = delete;
+
+   bool open( const std::string& filename, std::string& error );
+   void close();
+
+   // empty files map to nullptr with size 0
+   const char* data() const { return _Data; }
+   size_t size() const { return _Size; }
+
+private:
+   const char* _Data = nullptr;
+   size_t _Size = 0;
+#ifdef _WIN32
+   void* _File = nullptr;
+   void* _Mapping = nullptr;
+#else
+   int _Fd = -1;
+#endif
+};
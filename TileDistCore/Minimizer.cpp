@@ -0,0 +1,236 @@
+#include "Minimizer.h"
+
+#include <algorithm>
+
+namespace
+{
+   // no vertex moves further than this in one step, like Simulation::step()'s clamped velocities
+   const double MAX_MOVE = .1;
+
+   // FIRE's parameters as proposed by Bitzek et al.
+   const double FIRE_DT_START = .1;
+   const double FIRE_DT_MAX = .5;
+   const int FIRE_MIN_DOWNHILL = 5;
+   const double FIRE_DT_GROW = 1.1;
+   const double FIRE_DT_SHRINK = .5;
+   const double FIRE_ALPHA_START = .1;
+   const double FIRE_ALPHA_SHRINK = .99;
+
+   // corrections L-BFGS keeps
+   const int LBFGS_MEMORY = 8;
+   // sufficient decrease for the line search's Armijo condition
+   const double LBFGS_ARMIJO = 1e-4;
+   const int LBFGS_MAX_BACKTRACKS = 20;
+
+   double dot( const std::vector<XYZ>& a, const std::vector<XYZ>& b )
+   {
+      double ret = 0;
+      for ( size_t i = 0; i < a.size(); i++ )
+         ret += a[i] * b[i];
+      return ret;
+   }
+
+   double maxLen( const std::vector<XYZ>& a )
+   {
+      double ret = 0;
+      for ( const XYZ& x : a )
+         ret = std::max( ret, x.len() );
+      return ret;
+   }
+}
+
+StepStats FireMinimizer::step( Simulation& simulation )
+{
+   size_t n = simulation._Vertices.size();
+   if ( _Velocity.size() != n )
+   {
+      _Velocity.assign( n, XYZ() );
+      _Dt = FIRE_DT_START;
+      _Alpha = FIRE_ALPHA_START;
+      _NumDownhill = 0;
+   }
+
+   StepStats stats;
+   stats._Energy = simulation.energy( _Gradient );
+   stats._NumEvaluations = 1;
+
+   // the force is -_Gradient
+   double power = -dot( _Gradient, _Velocity );
+   if ( power > 0 )
+   {
+      if ( ++_NumDownhill > FIRE_MIN_DOWNHILL )
+      {
+         _Dt = std::min( _Dt * FIRE_DT_GROW, FIRE_DT_MAX );
+         _Alpha *= FIRE_ALPHA_SHRINK;
+      }
+   }
+   else
+   {
+      _NumDownhill = 0;
+      _Dt *= FIRE_DT_SHRINK;
+      _Alpha = FIRE_ALPHA_START;
+      std::fill( _Velocity.begin(), _Velocity.end(), XYZ() );
+   }
+
+   // semi-implicit Euler, then turn the velocity towards the force
+   for ( size_t i = 0; i < n; i++ )
+      _Velocity[i] -= _Gradient[i] * _Dt;
+   double forceLen = sqrt( dot( _Gradient, _Gradient ) );
+   if ( forceLen > 0 )
+   {
+      double velocityLen = sqrt( dot( _Velocity, _Velocity ) );
+      for ( size_t i = 0; i < n; i++ )
+         _Velocity[i] = _Velocity[i] * ( 1 - _Alpha ) - _Gradient[i] * ( _Alpha * velocityLen / forceLen );
+   }
+
+   std::vector<XYZ> delta( n );
+   for ( size_t i = 0; i < n; i++ )
+   {
+      delta[i] = _Velocity[i] * _Dt;
+      if ( delta[i].len() > MAX_MOVE )
+         delta[i] = delta[i].normalized() * MAX_MOVE;
+   }
+   simulation.displace( delta, stats );
+   return stats;
+}
+
+bool LbfgsMinimizer::isCurrent( const Simulation& simulation ) const
+{
+   if ( !_Valid || _Pos.size() != simulation._Vertices.size() )
+      return false;
+   for ( size_t i = 0; i < _Pos.size(); i++ )
+      if ( _Pos[i] != simulation._Vertices[i]._Pos )
+         return false;
+   const std::vector<PairDistances::Entry>& pairs = simulation._PairDistances.entries();
+   const std::vector<PairDistances::Entry>& ownPairs = _PairDistances.entries();
+   return _U == simulation._U && _V == simulation._V
+      && _MinDistanceAllowed == simulation._MinDistanceAllowed
+      && _MinDistanceAllowed_SameColor == simulation._MinDistanceAllowed_SameColor
+      && _ClickedVertex == simulation._ClickedVertex._Vertex
+      && _Symmetry == simulation._Symmetry
+      && std::equal( pairs.begin(), pairs.end(), ownPairs.begin(), ownPairs.end(), []( const PairDistances::Entry& a, const PairDistances::Entry& b )
+      {
+         return a._ColorA == b._ColorA && a._ColorB == b._ColorB && a._MinDist == b._MinDist;
+      } );
+}
+
+void LbfgsMinimizer::remember( const Simulation& simulation )
+{
+   _Pos.resize( simulation._Vertices.size() );
+   for ( size_t i = 0; i < _Pos.size(); i++ )
+      _Pos[i] = simulation._Vertices[i]._Pos;
+   _U = simulation._U;
+   _V = simulation._V;
+   _MinDistanceAllowed = simulation._MinDistanceAllowed;
+   _MinDistanceAllowed_SameColor = simulation._MinDistanceAllowed_SameColor;
+   _PairDistances = simulation._PairDistances;
+   _ClickedVertex = simulation._ClickedVertex._Vertex;
+   _Symmetry = simulation._Symmetry;
+   _Valid = true;
+}
+
+void LbfgsMinimizer::direction( std::vector<XYZ>& d ) const
+{
+   // the two-loop recursion, newest correction first
+   d = _Gradient;
+   std::vector<double> alpha( _Corrections.size() );
+   for ( int k = (int) _Corrections.size() - 1; k >= 0; k-- )
+   {
+      const Correction& c = _Corrections[k];
+      alpha[k] = c._Rho * dot( c._S, d );
+      for ( size_t i = 0; i < d.size(); i++ )
+         d[i] -= c._Y[i] * alpha[k];
+   }
+   if ( !_Corrections.empty() )
+   {
+      // initial Hessian guess s.y / y.y
+      const Correction& c = _Corrections.back();
+      double gamma = 1 / ( c._Rho * dot( c._Y, c._Y ) );
+      for ( XYZ& x : d )
+         x *= gamma;
+   }
+   for ( size_t k = 0; k < _Corrections.size(); k++ )
+   {
+      const Correction& c = _Corrections[k];
+      double beta = c._Rho * dot( c._Y, d );
+      for ( size_t i = 0; i < d.size(); i++ )
+         d[i] += c._S[i] * ( alpha[k] - beta );
+   }
+   for ( XYZ& x : d )
+      x = -x;
+}
+
+StepStats LbfgsMinimizer::step( Simulation& simulation )
+{
+   StepStats stats;
+   if ( !isCurrent( simulation ) )
+   {
+      // somebody else moved vertices or changed the energy, so the corrections no longer describe it
+      _Corrections.clear();
+      _Energy = simulation.energy( _Gradient );
+      stats._NumEvaluations++;
+      remember( simulation );
+   }
+   stats._Energy = _Energy;
+
+   std::vector<XYZ> d;
+   direction( d );
+   double slope = dot( _Gradient, d );
+   if ( slope >= 0 )
+   {
+      _Corrections.clear();
+      direction( d );
+      slope = dot( _Gradient, d );
+   }
+   if ( slope >= 0 )
+      return stats;
+
+   double alpha = std::min( 1., MAX_MOVE / maxLen( d ) );
+   size_t n = simulation._Vertices.size();
+   std::vector<XYZ> delta( n );
+   std::vector<XYZ> gradient;
+   double energy = _Energy;
+   bool accepted = false;
+   for ( int k = 0; k < LBFGS_MAX_BACKTRACKS && !accepted; k++, alpha *= .5 )
+   {
+      if ( k > 0 )
+      {
+         for ( size_t i = 0; i < n; i++ )
+            simulation._Vertices[i]._Pos = _Pos[i];
+      }
+      for ( size_t i = 0; i < n; i++ )
+         delta[i] = d[i] * alpha;
+      simulation.displace( delta, stats );
+      energy = simulation.energy( gradient );
+      stats._NumEvaluations++;
+      accepted = energy <= _Energy + LBFGS_ARMIJO * alpha * slope;
+   }
+   if ( !accepted )
+   {
+      // no decrease along d within float noise: stay put and start over from steepest descent
+      for ( size_t i = 0; i < n; i++ )
+         simulation._Vertices[i]._Pos = _Pos[i];
+      _Corrections.clear();
+      stats._MaxDisplacement = stats._RmsDisplacement = 0;
+      return stats;
+   }
+
+   Correction c;
+   c._S.swap( delta );
+   c._Y = gradient;
+   for ( size_t i = 0; i < n; i++ )
+      c._Y[i] -= _Gradient[i];
+   double sy = dot( c._S, c._Y );
+   // only curvature the energy really has keeps the inverse Hessian positive definite
+   if ( sy > 1e-12 * sqrt( dot( c._S, c._S ) * dot( c._Y, c._Y ) ) )
+   {
+      c._Rho = 1 / sy;
+      _Corrections.push_back( std::move( c ) );
+      if ( (int) _Corrections.size() > LBFGS_MEMORY )
+         _Corrections.pop_front();
+   }
+   _Gradient.swap( gradient );
+   _Energy = energy;
+   remember( simulation );
+   return stats;
+}
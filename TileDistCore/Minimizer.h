@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Simulation.h"
+
+#include <deque>
+#include <vector>
+
+// State of an energy minimiser between Simulation::step() calls. Every step() is one iteration of the method on
+// Simulation::energy(); a step never moves the clicked vertex.
+class IMinimizer
+{
+public:
+   virtual ~IMinimizer() {}
+   virtual StepStats step( Simulation& simulation ) = 0;
+};
+
+// FIRE, the fast inertial relaxation engine (Bitzek et al. 2006): damped dynamics whose velocity is turned
+// towards the force while the motion goes downhill and stopped as soon as it goes uphill. One energy
+// evaluation per step.
+class FireMinimizer : public IMinimizer
+{
+public:
+   StepStats step( Simulation& simulation ) override;
+
+private:
+   std::vector<XYZ> _Velocity;
+   std::vector<XYZ> _Gradient;
+   double _Dt = 0;
+   double _Alpha = 0;
+   // steps since the motion last went uphill
+   int _NumDownhill = 0;
+};
+
+// L-BFGS with a backtracking line search. The gradient of the accepted point is kept for the next step, so an
+// iteration usually costs one energy evaluation; it is evaluated afresh whenever anything it depends on changed.
+class LbfgsMinimizer : public IMinimizer
+{
+public:
+   StepStats step( Simulation& simulation ) override;
+
+private:
+   class Correction
+   {
+   public:
+      std::vector<XYZ> _S;
+      std::vector<XYZ> _Y;
+      double _Rho;
+   };
+
+private:
+   // simulation still has the positions, lattice, distances, clicked vertex and symmetry _Energy was evaluated for
+   bool isCurrent( const Simulation& simulation ) const;
+   void remember( const Simulation& simulation );
+   // -H * _Gradient from the stored corrections
+   void direction( std::vector<XYZ>& d ) const;
+
+private:
+   std::deque<Correction> _Corrections;
+   std::vector<XYZ> _Gradient;
+   double _Energy = 0;
+   std::vector<XYZ> _Pos;
+   XYZ _U;
+   XYZ _V;
+   double _MinDistanceAllowed = 0;
+   double _MinDistanceAllowed_SameColor = 0;
+   PairDistances _PairDistances;
+   const void* _ClickedVertex = nullptr;
+   Symmetry _Symmetry;
+   bool _Valid = false;
+};
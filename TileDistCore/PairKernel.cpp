@@ -0,0 +1,341 @@
+#include "PairKernel.h"
+
+#include <cmath>
+
+#if defined( __AVX2__ )
+#define PAIR_KERNEL_AVX2
+#include <immintrin.h>
+#elif defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define PAIR_KERNEL_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+   // the minimum distance of a pair, chosen between two
+   template<typename Real>
+   class TwoDistances
+   {
+   public:
+      Real operator()( int colorB ) const { return colorB == _ColorA ? _MinDistSameColor : _MinDist; }
+
+   public:
+      int _ColorA;
+      Real _MinDist;
+      Real _MinDistSameColor;
+   };
+
+   // the minimum distance of a pair, looked up in a's row of a MinDistanceTable
+   template<typename Real>
+   class DistanceRow
+   {
+   public:
+      Real operator()( int colorB ) const { return _Row[colorB]; }
+
+   public:
+      const Real* _Row;
+   };
+
+   template<typename Real, typename MinDistOf>
+   void accumulateScalar( Real ax, Real ay, MinDistOf minDistOf, const SoABuffer<Real>& b, int begin, int end, Real& sumX, Real& sumY, Real& overlap2 )
+   {
+      for ( int k = begin; k < end; k++ )
+      {
+         Real dx = ax - b._X[k];
+         Real dy = ay - b._Y[k];
+         Real dist2 = dx*dx + dy*dy;
+         Real md = minDistOf( b._Color[k] );
+         if ( dist2 >= md*md )
+            continue;
+         Real dist = std::sqrt( dist2 );
+         Real overlap = md - dist;
+         Real scale = overlap / dist;
+         sumX += dx * scale;
+         sumY += dy * scale;
+         overlap2 += overlap * overlap;
+      }
+   }
+
+#if defined( PAIR_KERNEL_AVX2 )
+   double horizontalSum( __m256d v )
+   {
+      __m128d s = _mm_add_pd( _mm256_castpd256_pd128( v ), _mm256_extractf128_pd( v, 1 ) );
+      return _mm_cvtsd_f64( _mm_add_sd( s, _mm_unpackhi_pd( s, s ) ) );
+   }
+   float horizontalSum( __m256 v )
+   {
+      __m128 s = _mm_add_ps( _mm256_castps256_ps128( v ), _mm256_extractf128_ps( v, 1 ) );
+      s = _mm_add_ps( s, _mm_movehl_ps( s, s ) );
+      return _mm_cvtss_f32( _mm_add_ss( s, _mm_shuffle_ps( s, s, 1 ) ) );
+   }
+#elif defined( PAIR_KERNEL_SSE2 )
+   double horizontalSum( __m128d v )
+   {
+      return _mm_cvtsd_f64( _mm_add_sd( v, _mm_unpackhi_pd( v, v ) ) );
+   }
+   float horizontalSum( __m128 v )
+   {
+      v = _mm_add_ps( v, _mm_movehl_ps( v, v ) );
+      return _mm_cvtss_f32( _mm_add_ss( v, _mm_shuffle_ps( v, v, 1 ) ) );
+   }
+   // SSE2 has no blendv
+   __m128d select( __m128d mask, __m128d ifFalse, __m128d ifTrue ) { return _mm_or_pd( _mm_and_pd( mask, ifTrue ), _mm_andnot_pd( mask, ifFalse ) ); }
+   __m128 select( __m128 mask, __m128 ifFalse, __m128 ifTrue ) { return _mm_or_ps( _mm_and_ps( mask, ifTrue ), _mm_andnot_ps( mask, ifFalse ) ); }
+#endif
+}
+
+void accumulateOverlap( double ax, double ay, int colorA, const SoABuffer<double>& b, int begin, int end, double minDist, double minDistSameColor, double& sumX, double& sumY, double& overlap2 )
+{
+   int k = begin;
+#if defined( PAIR_KERNEL_AVX2 )
+   __m256d vax = _mm256_set1_pd( ax );
+   __m256d vay = _mm256_set1_pd( ay );
+   __m256d vMinDist = _mm256_set1_pd( minDist );
+   __m256d vMinDistSame = _mm256_set1_pd( minDistSameColor );
+   __m128i vColorA = _mm_set1_epi32( colorA );
+   __m256d vSumX = _mm256_setzero_pd();
+   __m256d vSumY = _mm256_setzero_pd();
+   __m256d vOverlap2 = _mm256_setzero_pd();
+   for ( ; k + 4 <= end; k += 4 )
+   {
+      __m256d dx = _mm256_sub_pd( vax, _mm256_loadu_pd( &b._X[k] ) );
+      __m256d dy = _mm256_sub_pd( vay, _mm256_loadu_pd( &b._Y[k] ) );
+      __m256d dist2 = _mm256_add_pd( _mm256_mul_pd( dx, dx ), _mm256_mul_pd( dy, dy ) );
+      __m128i sameColor = _mm_cmpeq_epi32( vColorA, _mm_loadu_si128( (const __m128i*) &b._Color[k] ) );
+      __m256d md = _mm256_blendv_pd( vMinDist, vMinDistSame, _mm256_castsi256_pd( _mm256_cvtepi32_epi64( sameColor ) ) );
+      __m256d inRange = _mm256_cmp_pd( dist2, _mm256_mul_pd( md, md ), _CMP_LT_OQ );
+      if ( _mm256_movemask_pd( inRange ) == 0 )
+         continue;
+      __m256d dist = _mm256_sqrt_pd( dist2 );
+      __m256d overlap = _mm256_and_pd( inRange, _mm256_sub_pd( md, dist ) );
+      __m256d scale = _mm256_and_pd( inRange, _mm256_div_pd( overlap, dist ) );
+      vSumX = _mm256_add_pd( vSumX, _mm256_mul_pd( dx, scale ) );
+      vSumY = _mm256_add_pd( vSumY, _mm256_mul_pd( dy, scale ) );
+      vOverlap2 = _mm256_add_pd( vOverlap2, _mm256_mul_pd( overlap, overlap ) );
+   }
+   sumX += horizontalSum( vSumX );
+   sumY += horizontalSum( vSumY );
+   overlap2 += horizontalSum( vOverlap2 );
+#elif defined( PAIR_KERNEL_SSE2 )
+   __m128d vax = _mm_set1_pd( ax );
+   __m128d vay = _mm_set1_pd( ay );
+   __m128d vMinDist = _mm_set1_pd( minDist );
+   __m128d vMinDistSame = _mm_set1_pd( minDistSameColor );
+   __m128i vColorA = _mm_set1_epi32( colorA );
+   __m128d vSumX = _mm_setzero_pd();
+   __m128d vSumY = _mm_setzero_pd();
+   __m128d vOverlap2 = _mm_setzero_pd();
+   for ( ; k + 2 <= end; k += 2 )
+   {
+      __m128d dx = _mm_sub_pd( vax, _mm_loadu_pd( &b._X[k] ) );
+      __m128d dy = _mm_sub_pd( vay, _mm_loadu_pd( &b._Y[k] ) );
+      __m128d dist2 = _mm_add_pd( _mm_mul_pd( dx, dx ), _mm_mul_pd( dy, dy ) );
+      __m128i sameColor = _mm_cmpeq_epi32( vColorA, _mm_loadl_epi64( (const __m128i*) &b._Color[k] ) );
+      __m128d md = select( _mm_castsi128_pd( _mm_unpacklo_epi32( sameColor, sameColor ) ), vMinDist, vMinDistSame );
+      __m128d inRange = _mm_cmplt_pd( dist2, _mm_mul_pd( md, md ) );
+      if ( _mm_movemask_pd( inRange ) == 0 )
+         continue;
+      __m128d dist = _mm_sqrt_pd( dist2 );
+      __m128d overlap = _mm_and_pd( inRange, _mm_sub_pd( md, dist ) );
+      __m128d scale = _mm_and_pd( inRange, _mm_div_pd( overlap, dist ) );
+      vSumX = _mm_add_pd( vSumX, _mm_mul_pd( dx, scale ) );
+      vSumY = _mm_add_pd( vSumY, _mm_mul_pd( dy, scale ) );
+      vOverlap2 = _mm_add_pd( vOverlap2, _mm_mul_pd( overlap, overlap ) );
+   }
+   sumX += horizontalSum( vSumX );
+   sumY += horizontalSum( vSumY );
+   overlap2 += horizontalSum( vOverlap2 );
+#endif
+   accumulateScalar( ax, ay, TwoDistances<double>{ colorA, minDist, minDistSameColor }, b, k, end, sumX, sumY, overlap2 );
+}
+
+void accumulateOverlap( float ax, float ay, int colorA, const SoABuffer<float>& b, int begin, int end, float minDist, float minDistSameColor, float& sumX, float& sumY, float& overlap2 )
+{
+   int k = begin;
+#if defined( PAIR_KERNEL_AVX2 )
+   __m256 vax = _mm256_set1_ps( ax );
+   __m256 vay = _mm256_set1_ps( ay );
+   __m256 vMinDist = _mm256_set1_ps( minDist );
+   __m256 vMinDistSame = _mm256_set1_ps( minDistSameColor );
+   __m256i vColorA = _mm256_set1_epi32( colorA );
+   __m256 vSumX = _mm256_setzero_ps();
+   __m256 vSumY = _mm256_setzero_ps();
+   __m256 vOverlap2 = _mm256_setzero_ps();
+   for ( ; k + 8 <= end; k += 8 )
+   {
+      __m256 dx = _mm256_sub_ps( vax, _mm256_loadu_ps( &b._X[k] ) );
+      __m256 dy = _mm256_sub_ps( vay, _mm256_loadu_ps( &b._Y[k] ) );
+      __m256 dist2 = _mm256_add_ps( _mm256_mul_ps( dx, dx ), _mm256_mul_ps( dy, dy ) );
+      __m256i sameColor = _mm256_cmpeq_epi32( vColorA, _mm256_loadu_si256( (const __m256i*) &b._Color[k] ) );
+      __m256 md = _mm256_blendv_ps( vMinDist, vMinDistSame, _mm256_castsi256_ps( sameColor ) );
+      __m256 inRange = _mm256_cmp_ps( dist2, _mm256_mul_ps( md, md ), _CMP_LT_OQ );
+      if ( _mm256_movemask_ps( inRange ) == 0 )
+         continue;
+      __m256 dist = _mm256_sqrt_ps( dist2 );
+      __m256 overlap = _mm256_and_ps( inRange, _mm256_sub_ps( md, dist ) );
+      __m256 scale = _mm256_and_ps( inRange, _mm256_div_ps( overlap, dist ) );
+      vSumX = _mm256_add_ps( vSumX, _mm256_mul_ps( dx, scale ) );
+      vSumY = _mm256_add_ps( vSumY, _mm256_mul_ps( dy, scale ) );
+      vOverlap2 = _mm256_add_ps( vOverlap2, _mm256_mul_ps( overlap, overlap ) );
+   }
+   sumX += horizontalSum( vSumX );
+   sumY += horizontalSum( vSumY );
+   overlap2 += horizontalSum( vOverlap2 );
+#elif defined( PAIR_KERNEL_SSE2 )
+   __m128 vax = _mm_set1_ps( ax );
+   __m128 vay = _mm_set1_ps( ay );
+   __m128 vMinDist = _mm_set1_ps( minDist );
+   __m128 vMinDistSame = _mm_set1_ps( minDistSameColor );
+   __m128i vColorA = _mm_set1_epi32( colorA );
+   __m128 vSumX = _mm_setzero_ps();
+   __m128 vSumY = _mm_setzero_ps();
+   __m128 vOverlap2 = _mm_setzero_ps();
+   for ( ; k + 4 <= end; k += 4 )
+   {
+      __m128 dx = _mm_sub_ps( vax, _mm_loadu_ps( &b._X[k] ) );
+      __m128 dy = _mm_sub_ps( vay, _mm_loadu_ps( &b._Y[k] ) );
+      __m128 dist2 = _mm_add_ps( _mm_mul_ps( dx, dx ), _mm_mul_ps( dy, dy ) );
+      __m128i sameColor = _mm_cmpeq_epi32( vColorA, _mm_loadu_si128( (const __m128i*) &b._Color[k] ) );
+      __m128 md = select( _mm_castsi128_ps( sameColor ), vMinDist, vMinDistSame );
+      __m128 inRange = _mm_cmplt_ps( dist2, _mm_mul_ps( md, md ) );
+      if ( _mm_movemask_ps( inRange ) == 0 )
+         continue;
+      __m128 dist = _mm_sqrt_ps( dist2 );
+      __m128 overlap = _mm_and_ps( inRange, _mm_sub_ps( md, dist ) );
+      __m128 scale = _mm_and_ps( inRange, _mm_div_ps( overlap, dist ) );
+      vSumX = _mm_add_ps( vSumX, _mm_mul_ps( dx, scale ) );
+      vSumY = _mm_add_ps( vSumY, _mm_mul_ps( dy, scale ) );
+      vOverlap2 = _mm_add_ps( vOverlap2, _mm_mul_ps( overlap, overlap ) );
+   }
+   sumX += horizontalSum( vSumX );
+   sumY += horizontalSum( vSumY );
+   overlap2 += horizontalSum( vOverlap2 );
+#endif
+   accumulateScalar( ax, ay, TwoDistances<float>{ colorA, minDist, minDistSameColor }, b, k, end, sumX, sumY, overlap2 );
+}
+
+void accumulateOverlap( double ax, double ay, const double* minDistRow, const SoABuffer<double>& b, int begin, int end, double& sumX, double& sumY, double& overlap2 )
+{
+   int k = begin;
+#if defined( PAIR_KERNEL_AVX2 )
+   __m256d vax = _mm256_set1_pd( ax );
+   __m256d vay = _mm256_set1_pd( ay );
+   __m256d vSumX = _mm256_setzero_pd();
+   __m256d vSumY = _mm256_setzero_pd();
+   __m256d vOverlap2 = _mm256_setzero_pd();
+   for ( ; k + 4 <= end; k += 4 )
+   {
+      __m256d dx = _mm256_sub_pd( vax, _mm256_loadu_pd( &b._X[k] ) );
+      __m256d dy = _mm256_sub_pd( vay, _mm256_loadu_pd( &b._Y[k] ) );
+      __m256d dist2 = _mm256_add_pd( _mm256_mul_pd( dx, dx ), _mm256_mul_pd( dy, dy ) );
+      __m256d md = _mm256_i32gather_pd( minDistRow, _mm_loadu_si128( (const __m128i*) &b._Color[k] ), sizeof( double ) );
+      __m256d inRange = _mm256_cmp_pd( dist2, _mm256_mul_pd( md, md ), _CMP_LT_OQ );
+      if ( _mm256_movemask_pd( inRange ) == 0 )
+         continue;
+      __m256d dist = _mm256_sqrt_pd( dist2 );
+      __m256d overlap = _mm256_and_pd( inRange, _mm256_sub_pd( md, dist ) );
+      __m256d scale = _mm256_and_pd( inRange, _mm256_div_pd( overlap, dist ) );
+      vSumX = _mm256_add_pd( vSumX, _mm256_mul_pd( dx, scale ) );
+      vSumY = _mm256_add_pd( vSumY, _mm256_mul_pd( dy, scale ) );
+      vOverlap2 = _mm256_add_pd( vOverlap2, _mm256_mul_pd( overlap, overlap ) );
+   }
+   sumX += horizontalSum( vSumX );
+   sumY += horizontalSum( vSumY );
+   overlap2 += horizontalSum( vOverlap2 );
+#elif defined( PAIR_KERNEL_SSE2 )
+   __m128d vax = _mm_set1_pd( ax );
+   __m128d vay = _mm_set1_pd( ay );
+   __m128d vSumX = _mm_setzero_pd();
+   __m128d vSumY = _mm_setzero_pd();
+   __m128d vOverlap2 = _mm_setzero_pd();
+   for ( ; k + 2 <= end; k += 2 )
+   {
+      __m128d dx = _mm_sub_pd( vax, _mm_loadu_pd( &b._X[k] ) );
+      __m128d dy = _mm_sub_pd( vay, _mm_loadu_pd( &b._Y[k] ) );
+      __m128d dist2 = _mm_add_pd( _mm_mul_pd( dx, dx ), _mm_mul_pd( dy, dy ) );
+      // SSE2 has no gather
+      __m128d md = _mm_set_pd( minDistRow[b._Color[k+1]], minDistRow[b._Color[k]] );
+      __m128d inRange = _mm_cmplt_pd( dist2, _mm_mul_pd( md, md ) );
+      if ( _mm_movemask_pd( inRange ) == 0 )
+         continue;
+      __m128d dist = _mm_sqrt_pd( dist2 );
+      __m128d overlap = _mm_and_pd( inRange, _mm_sub_pd( md, dist ) );
+      __m128d scale = _mm_and_pd( inRange, _mm_div_pd( overlap, dist ) );
+      vSumX = _mm_add_pd( vSumX, _mm_mul_pd( dx, scale ) );
+      vSumY = _mm_add_pd( vSumY, _mm_mul_pd( dy, scale ) );
+      vOverlap2 = _mm_add_pd( vOverlap2, _mm_mul_pd( overlap, overlap ) );
+   }
+   sumX += horizontalSum( vSumX );
+   sumY += horizontalSum( vSumY );
+   overlap2 += horizontalSum( vOverlap2 );
+#endif
+   accumulateScalar( ax, ay, DistanceRow<double>{ minDistRow }, b, k, end, sumX, sumY, overlap2 );
+}
+
+void accumulateOverlap( float ax, float ay, const float* minDistRow, const SoABuffer<float>& b, int begin, int end, float& sumX, float& sumY, float& overlap2 )
+{
+   int k = begin;
+#if defined( PAIR_KERNEL_AVX2 )
+   __m256 vax = _mm256_set1_ps( ax );
+   __m256 vay = _mm256_set1_ps( ay );
+   __m256 vSumX = _mm256_setzero_ps();
+   __m256 vSumY = _mm256_setzero_ps();
+   __m256 vOverlap2 = _mm256_setzero_ps();
+   for ( ; k + 8 <= end; k += 8 )
+   {
+      __m256 dx = _mm256_sub_ps( vax, _mm256_loadu_ps( &b._X[k] ) );
+      __m256 dy = _mm256_sub_ps( vay, _mm256_loadu_ps( &b._Y[k] ) );
+      __m256 dist2 = _mm256_add_ps( _mm256_mul_ps( dx, dx ), _mm256_mul_ps( dy, dy ) );
+      __m256 md = _mm256_i32gather_ps( minDistRow, _mm256_loadu_si256( (const __m256i*) &b._Color[k] ), sizeof( float ) );
+      __m256 inRange = _mm256_cmp_ps( dist2, _mm256_mul_ps( md, md ), _CMP_LT_OQ );
+      if ( _mm256_movemask_ps( inRange ) == 0 )
+         continue;
+      __m256 dist = _mm256_sqrt_ps( dist2 );
+      __m256 overlap = _mm256_and_ps( inRange, _mm256_sub_ps( md, dist ) );
+      __m256 scale = _mm256_and_ps( inRange, _mm256_div_ps( overlap, dist ) );
+      vSumX = _mm256_add_ps( vSumX, _mm256_mul_ps( dx, scale ) );
+      vSumY = _mm256_add_ps( vSumY, _mm256_mul_ps( dy, scale ) );
+      vOverlap2 = _mm256_add_ps( vOverlap2, _mm256_mul_ps( overlap, overlap ) );
+   }
+   sumX += horizontalSum( vSumX );
+   sumY += horizontalSum( vSumY );
+   overlap2 += horizontalSum( vOverlap2 );
+#elif defined( PAIR_KERNEL_SSE2 )
+   __m128 vax = _mm_set1_ps( ax );
+   __m128 vay = _mm_set1_ps( ay );
+   __m128 vSumX = _mm_setzero_ps();
+   __m128 vSumY = _mm_setzero_ps();
+   __m128 vOverlap2 = _mm_setzero_ps();
+   for ( ; k + 4 <= end; k += 4 )
+   {
+      __m128 dx = _mm_sub_ps( vax, _mm_loadu_ps( &b._X[k] ) );
+      __m128 dy = _mm_sub_ps( vay, _mm_loadu_ps( &b._Y[k] ) );
+      __m128 dist2 = _mm_add_ps( _mm_mul_ps( dx, dx ), _mm_mul_ps( dy, dy ) );
+      __m128 md = _mm_set_ps( minDistRow[b._Color[k+3]], minDistRow[b._Color[k+2]], minDistRow[b._Color[k+1]], minDistRow[b._Color[k]] );
+      __m128 inRange = _mm_cmplt_ps( dist2, _mm_mul_ps( md, md ) );
+      if ( _mm_movemask_ps( inRange ) == 0 )
+         continue;
+      __m128 dist = _mm_sqrt_ps( dist2 );
+      __m128 overlap = _mm_and_ps( inRange, _mm_sub_ps( md, dist ) );
+      __m128 scale = _mm_and_ps( inRange, _mm_div_ps( overlap, dist ) );
+      vSumX = _mm_add_ps( vSumX, _mm_mul_ps( dx, scale ) );
+      vSumY = _mm_add_ps( vSumY, _mm_mul_ps( dy, scale ) );
+      vOverlap2 = _mm_add_ps( vOverlap2, _mm_mul_ps( overlap, overlap ) );
+   }
+   sumX += horizontalSum( vSumX );
+   sumY += horizontalSum( vSumY );
+   overlap2 += horizontalSum( vOverlap2 );
+#endif
+   accumulateScalar( ax, ay, DistanceRow<float>{ minDistRow }, b, k, end, sumX, sumY, overlap2 );
+}
+
+const char* pairKernelInstructionSet()
+{
+#if defined( PAIR_KERNEL_AVX2 )
+   return "AVX2";
+#elif defined( PAIR_KERNEL_SSE2 )
+   return "SSE2";
+#else
+   return "scalar";
+#endif
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "CellList.h"
+#include <cassert>
+#include <vector>
+
+// Positions and colours of all points in the slot order of a CellList, one array per component,
+// so that each cell's points are contiguous for the pair kernel.
+template<typename Real>
+class SoABuffer
+{
+public:
+   // colorOf( i ) gives the colour of point i
+   template<typename ColorOf> void build( const CellList& cells, ColorOf colorOf )
+   {
+      int n = cells.size();
+      _X.resize( n );
+      _Y.resize( n );
+      _Color.resize( n );
+      for ( int k = 0; k < n; k++ )
+      {
+         int i = cells.item( k );
+         _X[k] = (Real) cells.pos( i ).x;
+         _Y[k] = (Real) cells.pos( i ).y;
+         _Color[k] = colorOf( i );
+      }
+   }
+
+public:
+   std::vector<Real> _X;
+   std::vector<Real> _Y;
+   std::vector<int> _Color;
+};
+
+// Dense colour x colour minimum distances, row-major, for the kernels below that look the distance of every
+// pair up instead of choosing between two
+template<typename Real>
+class MinDistanceTable
+{
+public:
+   // colours in [0, numColors); distance( a, b ) gives the minimum distance of a pair
+   template<typename Distance> void build( int numColors, Distance distance )
+   {
+      _NumColors = numColors;
+      _Dist.resize( numColors * numColors );
+      for ( int a = 0; a < numColors; a++ )
+         for ( int b = 0; b < numColors; b++ )
+            _Dist[a * numColors + b] = (Real) distance( a, b );
+   }
+
+   int numColors() const { return _NumColors; }
+   const Real* row( int color ) const
+   {
+      assert( color >= 0 && color < _NumColors );
+      return &_Dist[color * _NumColors];
+   }
+   Real operator()( int colorA, int colorB ) const
+   {
+      assert( colorA >= 0 && colorA < _NumColors && colorB >= 0 && colorB < _NumColors );
+      return _Dist[colorA * _NumColors + colorB];
+   }
+
+private:
+   int _NumColors = 0;
+   std::vector<Real> _Dist;
+};
+
+// For every slot k in [begin, end) with |a - b_k| < minDist (minDistSameColor when the colours match),
+// adds (a - b_k) * (minDist - dist) / dist to (sumX, sumY) and (minDist - dist)^2 to overlap2.
+// Uses AVX2 when compiled with it (TileDistCore's EnableAVX2 property, e.g. msbuild /p:EnableAVX2=true), SSE2
+// otherwise, and processes 2-8 candidates per iteration.
+void accumulateOverlap( double ax, double ay, int colorA, const SoABuffer<double>& b, int begin, int end, double minDist, double minDistSameColor, double& sumX, double& sumY, double& overlap2 );
+void accumulateOverlap( float ax, float ay, int colorA, const SoABuffer<float>& b, int begin, int end, float minDist, float minDistSameColor, float& sumX, float& sumY, float& overlap2 );
+// Same with the minimum distance of each pair taken from a's row of a MinDistanceTable, which must cover every colour in b
+void accumulateOverlap( double ax, double ay, const double* minDistRow, const SoABuffer<double>& b, int begin, int end, double& sumX, double& sumY, double& overlap2 );
+void accumulateOverlap( float ax, float ay, const float* minDistRow, const SoABuffer<float>& b, int begin, int end, float& sumX, float& sumY, float& overlap2 );
+// "AVX2", "SSE2" or "scalar", whichever accumulateOverlap() was compiled with
+const char* pairKernelInstructionSet();
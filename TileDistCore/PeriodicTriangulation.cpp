@@ -0,0 +1,255 @@
+#include "PeriodicTriangulation.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <tuple>
+
+namespace
+{
+   double orient( const XYZ& a, const XYZ& b, const XYZ& c )
+   {
+      return ( b.x - a.x ) * ( c.y - a.y ) - ( b.y - a.y ) * ( c.x - a.x );
+   }
+
+   // > 0 if d lies inside the circumcircle of the counter-clockwise triangle a, b, c
+   double inCircle( const XYZ& a, const XYZ& b, const XYZ& c, const XYZ& d )
+   {
+      double adx = a.x - d.x, ady = a.y - d.y;
+      double bdx = b.x - d.x, bdy = b.y - d.y;
+      double cdx = c.x - d.x, cdy = c.y - d.y;
+      double ad2 = adx * adx + ady * ady;
+      double bd2 = bdx * bdx + bdy * bdy;
+      double cd2 = cdx * cdx + cdy * cdy;
+      return adx * ( bdy * cd2 - bd2 * cdy ) - ady * ( bdx * cd2 - bd2 * cdx ) + ad2 * ( bdx * cdy - bdy * cdx );
+   }
+
+   // relative tolerance of inCircle(), so that cocircular points don't flip back and forth
+   const double IN_CIRCLE_EPS = 1e-9;
+
+   // shifts the triangle so that its lowest corner, the same one periodicDelauney() anchors on, is in sector 0
+   void normalize( PeriodicTriangle& tri )
+   {
+      int anchor = 0;
+      for ( int k = 1; k < 3; k++ )
+      {
+         if ( std::make_tuple( tri._Index[k], tri._Sector[k].y, tri._Sector[k].x ) < std::make_tuple( tri._Index[anchor], tri._Sector[anchor].y, tri._Sector[anchor].x ) )
+            anchor = k;
+      }
+      Sector shift = tri._Sector[anchor];
+      for ( int k = 0; k < 3; k++ )
+         tri._Sector[k] = tri._Sector[k] - shift;
+   }
+
+   int next( int halfEdge ) { return halfEdge % 3 == 2 ? halfEdge - 2 : halfEdge + 1; }
+   int prev( int halfEdge ) { return halfEdge % 3 == 0 ? halfEdge + 2 : halfEdge - 1; }
+}
+
+void PeriodicTriangulation::clear()
+{
+   _Triangles.clear();
+   _Twin.clear();
+   _LastPos.clear();
+   _TopologyChanged = true;
+}
+
+void PeriodicTriangulation::update( const PeriodicVertices& vertices )
+{
+   ScopedTimer timer( "triangulation" );
+   _Rebuilt = false;
+   _Flips = 0;
+   bool sameShape = !_Triangles.empty() && _LastPos.size() == vertices._Vertices.size() && _U == vertices._U && _V == vertices._V;
+   if ( !sameShape || !trackWraps( vertices ) || !repair( vertices ) )
+      rebuild( vertices );
+   _TopologyChanged = _Rebuilt || _Flips > 0;
+
+   _LastPos.resize( vertices._Vertices.size() );
+   for ( int i = 0; i < (int) _LastPos.size(); i++ )
+      _LastPos[i] = vertices._Vertices[i]._Pos;
+}
+
+void PeriodicTriangulation::rebuild( const PeriodicVertices& vertices )
+{
+   _Rebuilt = true;
+   _U = vertices._U;
+   _V = vertices._V;
+   _Triangles = periodicDelauney( vertices );
+
+   // a half-edge a -> b with b in sector s relative to a is twinned with b -> a with a in sector -s
+   std::map<std::tuple<int, int, int, int>, int> halfEdges;
+   for ( int t = 0; t < (int) _Triangles.size(); t++ )
+   {
+      const PeriodicTriangle& tri = _Triangles[t];
+      for ( int k = 0; k < 3; k++ )
+      {
+         int l = ( k + 1 ) % 3;
+         Sector offset = tri._Sector[l] - tri._Sector[k];
+         halfEdges[std::make_tuple( tri._Index[k], tri._Index[l], offset.x, offset.y )] = 3 * t + k;
+      }
+   }
+   _Twin.assign( 3 * _Triangles.size(), -1 );
+   for ( const auto& halfEdge : halfEdges )
+   {
+      int a, b, x, y;
+      std::tie( a, b, x, y ) = halfEdge.first;
+      auto twin = halfEdges.find( std::make_tuple( b, a, -x, -y ) );
+      if ( twin != halfEdges.end() )
+         _Twin[halfEdge.second] = twin->second;
+   }
+}
+
+bool PeriodicTriangulation::trackWraps( const PeriodicVertices& vertices )
+{
+   // setPos() wraps vertices back into the fundamental domain; compensate in the corners that refer to them
+   double det = _U.x * _V.y - _U.y * _V.x;
+   std::vector<Sector> jump( _LastPos.size(), Sector { 0, 0 } );
+   bool anyJump = false;
+   for ( int i = 0; i < (int) _LastPos.size(); i++ )
+   {
+      XYZ d = vertices._Vertices[i]._Pos - _LastPos[i];
+      int a = (int) lround( ( d.x * _V.y - d.y * _V.x ) / det );
+      int b = (int) lround( ( _U.x * d.y - _U.y * d.x ) / det );
+      if ( a != 0 || b != 0 )
+      {
+         jump[i] = Sector { a, b };
+         anyJump = true;
+      }
+   }
+   if ( anyJump )
+   {
+      for ( PeriodicTriangle& tri : _Triangles )
+      {
+         for ( int k = 0; k < 3; k++ )
+            tri._Sector[k] = tri._Sector[k] - jump[tri._Index[k]];
+         normalize( tri );
+      }
+   }
+
+   // flips can only repair a triangulation in which every triangle still has its orientation and
+   // the triangles cover the fundamental domain exactly once
+   double area = 0;
+   for ( int t = 0; t < (int) _Triangles.size(); t++ )
+   {
+      double a = orient( cornerPos( vertices, t, 0, Sector { 0, 0 } ), cornerPos( vertices, t, 1, Sector { 0, 0 } ), cornerPos( vertices, t, 2, Sector { 0, 0 } ) );
+      if ( a <= 0 )
+         return false;
+      area += a;
+   }
+   // orient() is twice the area
+   return fabs( area - 2 * fabs( det ) ) <= 1e-6 * fabs( det );
+}
+
+bool PeriodicTriangulation::isPositive( const PeriodicVertices& vertices, int triangle ) const
+{
+   return orient( cornerPos( vertices, triangle, 0, Sector { 0, 0 } ), cornerPos( vertices, triangle, 1, Sector { 0, 0 } ), cornerPos( vertices, triangle, 2, Sector { 0, 0 } ) ) > 0;
+}
+
+XYZ PeriodicTriangulation::cornerPos( const PeriodicVertices& vertices, int triangle, int corner, const Sector& shift ) const
+{
+   const PeriodicTriangle& tri = _Triangles[triangle];
+   return vertices.pos( vertices._Vertices[tri._Index[corner]]._Pos, tri._Sector[corner] + shift );
+}
+
+Sector PeriodicTriangulation::twinShift( int halfEdge ) const
+{
+   // translation that puts the twin's triangle next to halfEdge's triangle
+   int twin = _Twin[halfEdge];
+   return _Triangles[halfEdge / 3]._Sector[halfEdge % 3] - _Triangles[twin / 3]._Sector[next( twin ) % 3];
+}
+
+bool PeriodicTriangulation::isLegal( const PeriodicVertices& vertices, int halfEdge ) const
+{
+   int t = halfEdge / 3;
+   int k = halfEdge % 3;
+   int twin = _Twin[halfEdge];
+   XYZ a = cornerPos( vertices, t, k, Sector { 0, 0 } );
+   XYZ b = cornerPos( vertices, t, ( k + 1 ) % 3, Sector { 0, 0 } );
+   XYZ c = cornerPos( vertices, t, ( k + 2 ) % 3, Sector { 0, 0 } );
+   XYZ d = cornerPos( vertices, twin / 3, prev( twin ) % 3, twinShift( halfEdge ) );
+
+   double scale = std::max( std::max( a.dist2( d ), b.dist2( d ) ), c.dist2( d ) );
+   return inCircle( a, b, c, d ) <= IN_CIRCLE_EPS * scale * scale;
+}
+
+void PeriodicTriangulation::flip( int halfEdge )
+{
+   // triangles a b c and b a d become a d c and d b c
+   int t = halfEdge / 3;
+   int twin = _Twin[halfEdge];
+   int t2 = twin / 3;
+   Sector shift = twinShift( halfEdge );
+
+   const PeriodicTriangle& T = _Triangles[t];
+   const PeriodicTriangle& T2 = _Triangles[t2];
+   int ka = halfEdge % 3, kb = next( halfEdge ) % 3, kc = prev( halfEdge ) % 3, kd = prev( twin ) % 3;
+   int a = T._Index[ka], b = T._Index[kb], c = T._Index[kc], d = T2._Index[kd];
+   Sector sa = T._Sector[ka], sb = T._Sector[kb], sc = T._Sector[kc], sd = T2._Sector[kd] + shift;
+
+   // old half-edges on the outside of the quad and where they end up
+   int oldBC = next( halfEdge ), oldCA = prev( halfEdge ), oldAD = next( twin ), oldDB = prev( twin );
+   int newAD = 3 * t + 0, newDC = 3 * t + 1, newCA = 3 * t + 2;
+   int newDB = 3 * t2 + 0, newBC = 3 * t2 + 1, newCD = 3 * t2 + 2;
+   int outer[4][2] = { { oldBC, newBC }, { oldCA, newCA }, { oldAD, newAD }, { oldDB, newDB } };
+   int outerTwin[4];
+   for ( int i = 0; i < 4; i++ )
+      outerTwin[i] = _Twin[outer[i][0]];
+   auto remap = [&]( int h )
+   {
+      for ( int i = 0; i < 4; i++ )
+         if ( outer[i][0] == h )
+            return outer[i][1];
+      return h;
+   };
+
+   _Triangles[t] = PeriodicTriangle { { a, d, c }, { sa, sd, sc } };
+   _Triangles[t2] = PeriodicTriangle { { d, b, c }, { sd, sb, sc } };
+   normalize( _Triangles[t] );
+   normalize( _Triangles[t2] );
+
+   for ( int i = 0; i < 4; i++ )
+   {
+      int h = outer[i][1];
+      int h2 = remap( outerTwin[i] );
+      _Twin[h] = h2;
+      _Twin[h2] = h;
+   }
+   _Twin[newDC] = newCD;
+   _Twin[newCD] = newDC;
+}
+
+bool PeriodicTriangulation::repair( const PeriodicVertices& vertices )
+{
+   int maxFlips = std::max( 16, (int) vertices._Vertices.size() );
+   std::vector<int> stack;
+   for ( int h = 0; h < (int) _Twin.size(); h++ )
+   {
+      if ( _Twin[h] < 0 )
+         return false;
+      if ( h < _Twin[h] )
+         stack.push_back( h );
+   }
+
+   while ( !stack.empty() )
+   {
+      int h = stack.back();
+      stack.pop_back();
+      if ( isLegal( vertices, h ) )
+         continue;
+      if ( _Flips == maxFlips || _Twin[h] / 3 == h / 3 )
+         return false;
+
+      int t = h / 3;
+      int t2 = _Twin[h] / 3;
+      flip( h );
+      _Flips++;
+      if ( !isPositive( vertices, t ) || !isPositive( vertices, t2 ) )
+         return false;
+      // the four outer edges of the quad may have become illegal
+      stack.push_back( 3 * t + 0 );
+      stack.push_back( 3 * t + 2 );
+      stack.push_back( 3 * t2 + 0 );
+      stack.push_back( 3 * t2 + 1 );
+   }
+   return true;
+}
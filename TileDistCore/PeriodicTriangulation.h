@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Delauney.h"
+
+#include <vector>
+
+// Periodic Delaunay triangulation that is kept across updates. Small moves are repaired with edge flips;
+// it is rebuilt from scratch when the vertex count or lattice changes, when a triangle has turned over or
+// when the repair needs more flips than there are vertices.
+class PeriodicTriangulation
+{
+public:
+   // brings the triangulation up to date with the vertices' current positions
+   void update( const PeriodicVertices& vertices );
+   void clear();
+
+   const std::vector<PeriodicTriangle>& triangles() const { return _Triangles; }
+   // false if the last update() left every vertex with the same neighbours, so derived data can be reused
+   bool topologyChanged() const { return _TopologyChanged; }
+   bool lastUpdateRebuilt() const { return _Rebuilt; }
+   int lastUpdateFlips() const { return _Flips; }
+
+private:
+   void rebuild( const PeriodicVertices& vertices );
+   bool trackWraps( const PeriodicVertices& vertices );
+   bool repair( const PeriodicVertices& vertices );
+   bool isPositive( const PeriodicVertices& vertices, int triangle ) const;
+   bool isLegal( const PeriodicVertices& vertices, int halfEdge ) const;
+   void flip( int halfEdge );
+   XYZ cornerPos( const PeriodicVertices& vertices, int triangle, int corner, const Sector& shift ) const;
+   Sector twinShift( int halfEdge ) const;
+
+private:
+   std::vector<PeriodicTriangle> _Triangles;
+   // half-edge 3*t+k runs from corner k to corner k+1 of triangle t; _Twin holds the opposite half-edge
+   std::vector<int> _Twin;
+   std::vector<XYZ> _LastPos;
+   XYZ _U;
+   XYZ _V;
+   bool _TopologyChanged = true;
+   bool _Rebuilt = false;
+   int _Flips = 0;
+};
@@ -0,0 +1,144 @@
+#include "Profiler.h"
+#include "JsonWriter.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+   // weight of the newest call in PhaseStats::_AverageMs
+   const double AVERAGE_WEIGHT = .1;
+
+   // small stable numbers for the trace viewer's thread rows
+   int threadNumber()
+   {
+      static std::atomic<int> s_NextThread { 1 };
+      thread_local int t_Thread = s_NextThread++;
+      return t_Thread;
+   }
+}
+
+std::atomic<bool> Profiler::s_Active { false };
+
+Profiler& Profiler::instance()
+{
+   static Profiler s_Profiler;
+   return s_Profiler;
+}
+
+void Profiler::setCollecting( bool collecting )
+{
+   std::lock_guard<std::mutex> lock( _Mutex );
+   _Collecting = collecting;
+   updateActive();
+}
+
+std::vector<PhaseStats> Profiler::phases() const
+{
+   std::lock_guard<std::mutex> lock( _Mutex );
+   return _Phases;
+}
+
+void Profiler::startTrace()
+{
+   std::lock_guard<std::mutex> lock( _Mutex );
+   _Events.clear();
+   _TraceStart = Clock::now();
+   _Tracing = true;
+   updateActive();
+}
+
+bool Profiler::writeTrace( const std::string& filename, std::string& error )
+{
+   std::vector<TraceEvent> events;
+   Clock::time_point traceStart;
+   {
+      std::lock_guard<std::mutex> lock( _Mutex );
+      _Tracing = false;
+      updateActive();
+      events.swap( _Events );
+      traceStart = _TraceStart;
+   }
+
+   FILE* f = fopen( filename.c_str(), "wb" );
+   if ( !f )
+   {
+      error = "cannot write " + filename;
+      return false;
+   }
+   bool ok;
+   {
+      // complete events ("ph":"X") with microsecond timestamps
+      JsonWriter writer( f, true );
+      writer.beginObject();
+      writer.key( "displayTimeUnit" );
+      writer.value( "ms" );
+      writer.key( "traceEvents" );
+      writer.beginArray();
+      for ( const TraceEvent& event : events )
+      {
+         writer.beginObject();
+         writer.key( "dur" );
+         writer.value( std::chrono::duration<double, std::micro>( event._End - event._Start ).count() );
+         writer.key( "name" );
+         writer.value( event._Name );
+         writer.key( "ph" );
+         writer.value( "X" );
+         writer.key( "pid" );
+         writer.value( 1 );
+         writer.key( "tid" );
+         writer.value( event._Thread );
+         writer.key( "ts" );
+         writer.value( std::chrono::duration<double, std::micro>( event._Start - traceStart ).count() );
+         writer.endObject();
+      }
+      writer.endArray();
+      writer.endObject();
+      writer.end();
+      ok = writer.flush();
+   }
+   if ( fclose( f ) != 0 || !ok )
+   {
+      error = "cannot write " + filename;
+      return false;
+   }
+   return true;
+}
+
+void Profiler::record( const char* name, Clock::time_point start, Clock::time_point end )
+{
+   int thread = threadNumber();
+   double ms = std::chrono::duration<double, std::milli>( end - start ).count();
+
+   std::lock_guard<std::mutex> lock( _Mutex );
+   if ( _Collecting )
+   {
+      // few phases, and almost always the same pointer
+      PhaseStats* phase = nullptr;
+      for ( PhaseStats& p : _Phases )
+      {
+         if ( p._Name == name || strcmp( p._Name, name ) == 0 )
+         {
+            phase = &p;
+            break;
+         }
+      }
+      if ( !phase )
+      {
+         _Phases.push_back( PhaseStats() );
+         phase = &_Phases.back();
+         phase->_Name = name;
+         phase->_AverageMs = ms;
+      }
+      phase->_Calls++;
+      phase->_LastMs = ms;
+      phase->_AverageMs += AVERAGE_WEIGHT * ( ms - phase->_AverageMs );
+   }
+   if ( _Tracing )
+      _Events.push_back( TraceEvent{ name, thread, start, end } );
+}
+
+void Profiler::updateActive()
+{
+   s_Active = _Collecting || _Tracing;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// running timings of one named phase
+class PhaseStats
+{
+public:
+   const char* _Name = nullptr;
+   long long _Calls = 0;
+   double _LastMs = 0;
+   // exponentially weighted over the recent calls
+   double _AverageMs = 0;
+};
+
+// Process-wide collection of ScopedTimer measurements, for the live overlay (setCollecting) and for
+// Chrome trace files (startTrace). While neither is on, a ScopedTimer costs one relaxed atomic load.
+class Profiler
+{
+public:
+   typedef std::chrono::steady_clock Clock;
+
+public:
+   static Profiler& instance();
+   static bool isActive() { return s_Active.load( std::memory_order_relaxed ); }
+
+   void setCollecting( bool collecting );
+   bool isCollecting() const { return _Collecting; }
+   // snapshot of every phase timed while collecting, in order of first appearance
+   std::vector<PhaseStats> phases() const;
+
+   // records every timed scope from now on, until writeTrace()
+   void startTrace();
+   bool isTracing() const { return _Tracing; }
+   // stops recording and writes the events in Chrome trace_event format (chrome://tracing, Perfetto)
+   bool writeTrace( const std::string& filename, std::string& error );
+
+   // name must outlive the profiler, normally a string literal
+   void record( const char* name, Clock::time_point start, Clock::time_point end );
+
+private:
+   class TraceEvent
+   {
+   public:
+      const char* _Name;
+      int _Thread;
+      Clock::time_point _Start;
+      Clock::time_point _End;
+   };
+
+private:
+   void updateActive();
+
+private:
+   static std::atomic<bool> s_Active;
+
+   mutable std::mutex _Mutex;
+   bool _Collecting = false;
+   bool _Tracing = false;
+   Clock::time_point _TraceStart;
+   std::vector<PhaseStats> _Phases;
+   std::vector<TraceEvent> _Events;
+};
+
+// times the enclosing scope under name, which must be a string literal
+class ScopedTimer
+{
+public:
+   explicit ScopedTimer( const char* name ) { start( name ); }
+   ~ScopedTimer() { stop(); }
+   // ends the current phase and times the rest of the scope under name
+   void next( const char* name ) { stop(); start( name ); }
+   ScopedTimer( const ScopedTimer& ) = delete;
+   ScopedTimer& operator=( const ScopedTimer& ) = delete;
+
+private:
+   void start( const char* name )
+   {
+      if ( !Profiler::isActive() )
+         return;
+      _Name = name;
+      _Start = Profiler::Clock::now();
+   }
+   void stop()
+   {
+      if ( _Name )
+         Profiler::instance().record( _Name, _Start, Profiler::Clock::now() );
+      _Name = nullptr;
+   }
+
+private:
+   const char* _Name = nullptr;
+   Profiler::Clock::time_point _Start;
+};
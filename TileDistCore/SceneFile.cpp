@@ -0,0 +1,84 @@
+#include "SceneFile.h"
+#include "Simulation.h"
+
+#include <fstream>
+#include <sstream>
+
+bool loadScene( const std::string& filename, Simulation& simulation, std::string& error )
+{
+   std::ifstream f( filename );
+   if ( !f )
+   {
+      error = "cannot open " + filename;
+      return false;
+   }
+
+   XYZ u = simulation._U;
+   XYZ v = simulation._V;
+   Symmetry symmetry = simulation._Symmetry;
+   std::string line;
+   for ( int lineNumber = 1; std::getline( f, line ); lineNumber++ )
+   {
+      line = line.substr( 0, line.find( '#' ) );
+      std::istringstream ss( line );
+      std::string key;
+      if ( !(ss >> key) )
+         continue;
+
+      bool ok;
+      if ( key == "u" )
+         ok = (bool) (ss >> u.x >> u.y);
+      else if ( key == "v" )
+         ok = (bool) (ss >> v.x >> v.y);
+      else if ( key == "minDist" )
+         ok = (bool) (ss >> simulation._MinDistanceAllowed);
+      else if ( key == "minDistSameColor" )
+         ok = (bool) (ss >> simulation._MinDistanceAllowed_SameColor);
+      else if ( key == "minDistPair" )
+      {
+         int colorA, colorB;
+         double d;
+         ok = (bool) (ss >> colorA >> colorB >> d) && colorA >= 0 && colorB >= 0 && d >= 0;
+         if ( ok )
+            simulation._PairDistances.set( colorA, colorB, d );
+      }
+      else if ( key == "symmetry" )
+      {
+         std::string rest;
+         std::getline( ss, rest );
+         if ( !symmetry.parse( rest, error ) )
+         {
+            error = filename + ":" + std::to_string( lineNumber ) + ": " + error;
+            return false;
+         }
+         ok = true;
+      }
+      else if ( key == "tension" )
+         ok = (bool) (ss >> simulation._Tension);
+      else if ( key == "vertex" )
+      {
+         XYZ pos;
+         int color;
+         ok = (bool) (ss >> pos.x >> pos.y >> color) && color >= 0;
+         if ( ok )
+            simulation.addVertex( pos, color );
+      }
+      else
+      {
+         error = filename + ":" + std::to_string( lineNumber ) + ": unknown key '" + key + "'";
+         return false;
+      }
+      if ( !ok )
+      {
+         error = filename + ":" + std::to_string( lineNumber ) + ": bad value for '" + key + "'";
+         return false;
+      }
+   }
+   simulation.setUV( u, v );
+   if ( !simulation.setSymmetry( symmetry, error ) )
+   {
+      error = filename + ": " + error;
+      return false;
+   }
+   return true;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+
+class Simulation;
+
+// Plain text scene description, one entry per line ('#' starts a comment):
+//    u <x> <y>
+//    v <x> <y>
+//    minDist <d>
+//    minDistSameColor <d>
+//    minDistPair <colorA> <colorB> <d>
+//    symmetry <group> [<color permutation>]     e.g. "symmetry p3 1 2 0", see Symmetry::parse()
+//    tension <t>
+//    vertex <x> <y> <color>
+// Colours and distances must not be negative.
+bool loadScene( const std::string& filename, Simulation& simulation, std::string& error );
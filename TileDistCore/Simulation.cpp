@@ -0,0 +1,568 @@
+#include "Simulation.h"
+#include "Minimizer.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <sstream>
+#include <type_traits>
+
+Simulation::Simulation()
+{
+   double scale = 2.4;
+   setUV( XYZ( 1, 0, 0 ) * scale, XYZ( .5, sqrt(.75), 0 ) * scale );
+}
+
+Simulation::~Simulation()
+{
+}
+
+void Simulation::setUV( const XYZ& u, const XYZ& v )
+{
+   _U = u;
+   _V = v;
+   _Lattice = Lattice2D( _U, _V );
+   // the rotation centres move with the lattice
+   moveOffCentres();
+}
+
+bool Simulation::setUV( const XYZ& u, const XYZ& v, std::string& error )
+{
+   if ( !_Symmetry.fits( Lattice2D( u, v ) ) )
+   {
+      error = "the lattice has no " + std::to_string( _Symmetry.order() ) + "-fold rotation about the origin, set the symmetry to p1 first";
+      return false;
+   }
+   setUV( u, v );
+   return true;
+}
+
+bool Simulation::setSymmetry( const Symmetry& symmetry, std::string& error )
+{
+   if ( !symmetry.fits( _Lattice ) )
+   {
+      error = "the lattice has no " + std::to_string( symmetry.order() ) + "-fold rotation about the origin";
+      return false;
+   }
+   _Symmetry = symmetry;
+   moveOffCentres();
+   // the clicked image may not exist any more
+   _ClickedVertex = VertexPtr();
+   _ClickedElement = 0;
+   return true;
+}
+
+std::vector<Sector> PeriodicVertices::sectorsInRange( const XYZ& center, double R ) const
+{
+   std::vector<Sector> ret;
+   double det = _U.x * _V.y - _U.y * _V.x;
+   if ( det == 0 || R < 0 )
+      return ret;
+
+   Lattice2D lattice( _U, _V );
+   XYZ c = lattice.toLattice( center );
+   // the points of the disc where the U lattice coordinate is smallest and largest
+   XYZ gradA( _V.y / det, -_V.x / det, 0 );
+   XYZ extremes[2] = { lattice.toLattice( center - gradA * ( R / gradA.len() ) ), lattice.toLattice( center + gradA * ( R / gradA.len() ) ) };
+   double rangeB = R * _U.len() / fabs( det );
+   double u2 = _U.len2();
+   for ( int y = (int) floor( c.y - rangeB ); y <= (int) floor( c.y + rangeB ); y++ )
+   {
+      // the disc between the lines of V coordinate y and y + 1 reaches furthest along U at the ends of its
+      // chords on them or at its extremes, if those lie in between
+      double minA = INFINITY;
+      double maxA = -INFINITY;
+      for ( double b : { (double) y, y + 1. } )
+      {
+         // solve |q + U x| <= R for x, with q the line's point at U coordinate 0, relative to center
+         XYZ q = _V * b - center;
+         double qu = q * _U;
+         double disc = qu * qu - u2 * ( q.len2() - R*R );
+         if ( disc < 0 )
+            continue;
+         double root = sqrt( disc );
+         minA = std::min( minA, ( -qu - root ) / u2 );
+         maxA = std::max( maxA, ( -qu + root ) / u2 );
+      }
+      for ( const XYZ& extreme : extremes )
+      {
+         if ( extreme.y >= y && extreme.y <= y + 1 )
+         {
+            minA = std::min( minA, extreme.x );
+            maxA = std::max( maxA, extreme.x );
+         }
+      }
+      if ( minA > maxA )
+         continue;
+      for ( int x = (int) floor( minA ); x <= (int) floor( maxA ); x++ )
+         ret.push_back( { x, y } );
+   }
+   return ret;
+}
+
+std::vector<VertexPtr> PeriodicVertices::rawVertices() const
+{
+   std::vector<VertexPtr> ret;
+   Sector sector = { 0, 0 };
+   for ( const Vertex& a : _Vertices )
+   {
+      ret.push_back( VertexPtr( &a, sector, this ) );
+   }
+   return ret;
+}
+
+VertexPtr PeriodicVertices::rawVertex( int index ) const
+{
+   if ( index < 0 || index >= (int) _Vertices.size() )
+      return VertexPtr();
+   return VertexPtr( &_Vertices[index], Sector{ 0, 0 }, this );
+}
+
+std::vector<VertexPtr> PeriodicVertices::verticesInRange( double R ) const
+{
+   std::vector<VertexPtr> ret;
+   double det = _U.x * _V.y - _U.y * _V.x;
+   if ( det == 0 || R < 0 )
+      return ret;
+
+   // a point within R of the origin has its V lattice coordinate within R * |U| / |det| of 0
+   double rangeB = R * _U.len() / fabs( det );
+   double u2 = _U.len2();
+   for ( const Vertex& aa : _Vertices )
+   {
+      double b = ( _U.x * aa._Pos.y - _U.y * aa._Pos.x ) / det;
+      Sector sector;
+      for ( sector.y = (int) floor( -rangeB - b ); sector.y <= (int) ceil( rangeB - b ); sector.y++ )
+      {
+         // solve |q + U x| <= R for x, with q the vertex shifted by sector.y * V
+         XYZ q = aa._Pos + _V * sector.y;
+         double qu = q.x * _U.x + q.y * _U.y;
+         double disc = qu * qu - u2 * ( q.len2() - R*R );
+         if ( disc < 0 )
+            continue;
+         double root = sqrt( disc );
+         // one extra sector on each side against rounding, the exact test follows
+         for ( sector.x = (int) floor( ( -qu - root ) / u2 ) - 1; sector.x <= (int) ceil( ( -qu + root ) / u2 ) + 1; sector.x++ )
+         {
+            VertexPtr a( &aa, sector, this );
+            if ( a.pos().len2() > R*R )
+               continue;
+            ret.push_back( a );
+         }
+      }
+   }
+   return ret;
+}
+
+Sector Simulation::sectorAt( const XYZ& p ) const
+{
+   XYZ ab = _Lattice.toLattice( p );
+   return Sector{ (int)floor( ab.x ), (int)floor( ab.y ) };
+}
+
+void PairDistances::set( int colorA, int colorB, double minDist )
+{
+   if ( colorA > colorB )
+      std::swap( colorA, colorB );
+   auto it = std::lower_bound( _Entries.begin(), _Entries.end(), std::make_pair( colorA, colorB ), []( const Entry& e, const std::pair<int, int>& key )
+   {
+      return std::make_pair( e._ColorA, e._ColorB ) < key;
+   } );
+   if ( it != _Entries.end() && it->_ColorA == colorA && it->_ColorB == colorB )
+      it->_MinDist = minDist;
+   else
+      _Entries.insert( it, Entry{ colorA, colorB, minDist } );
+}
+
+void PairDistances::erase( int colorA, int colorB )
+{
+   if ( colorA > colorB )
+      std::swap( colorA, colorB );
+   _Entries.erase( std::remove_if( _Entries.begin(), _Entries.end(), [&]( const Entry& e ) { return e._ColorA == colorA && e._ColorB == colorB; } ), _Entries.end() );
+}
+
+bool PairDistances::find( int colorA, int colorB, double& minDist ) const
+{
+   if ( colorA > colorB )
+      std::swap( colorA, colorB );
+   for ( const Entry& e : _Entries )
+   {
+      if ( e._ColorA == colorA && e._ColorB == colorB )
+      {
+         minDist = e._MinDist;
+         return true;
+      }
+   }
+   return false;
+}
+
+double PairDistances::maxDistance() const
+{
+   double ret = 0;
+   for ( const Entry& e : _Entries )
+      ret = std::max( ret, e._MinDist );
+   return ret;
+}
+
+std::string PairDistances::toString() const
+{
+   std::ostringstream ss;
+   for ( const Entry& e : _Entries )
+      ss << ( &e == &_Entries[0] ? "" : " " ) << e._ColorA << "-" << e._ColorB << ":" << e._MinDist;
+   return ss.str();
+}
+
+bool PairDistances::parse( const std::string& str, std::string& error )
+{
+   PairDistances parsed;
+   std::istringstream ss( str );
+   std::string item;
+   while ( ss >> item )
+   {
+      int colorA, colorB;
+      double minDist;
+      char dash, colon;
+      std::istringstream itemStream( item );
+      if ( !( itemStream >> colorA >> dash >> colorB >> colon >> minDist ) || dash != '-' || colon != ':' || colorA < 0 || colorB < 0 || minDist < 0 )
+      {
+         error = "bad pair distance '" + item + "', expected colorA-colorB:dist";
+         return false;
+      }
+      parsed.set( colorA, colorB, minDist );
+   }
+   *this = parsed;
+   return true;
+}
+
+double Simulation::minDistance( int colorA, int colorB ) const
+{
+   double ret;
+   if ( _PairDistances.find( colorA, colorB, ret ) )
+      return ret;
+   return colorA == colorB ? _MinDistanceAllowed_SameColor : _MinDistanceAllowed;
+}
+
+double Simulation::maxMinDistance() const
+{
+   return std::max( { _MinDistanceAllowed, _MinDistanceAllowed_SameColor, _PairDistances.maxDistance() } );
+}
+
+void Simulation::collectImages( std::vector<XYZ>& positions, std::vector<int>& colors, std::vector<ImageSource>& sources ) const
+{
+   positions.clear();
+   colors.clear();
+   sources.clear();
+   positions.reserve( _Vertices.size() * _Symmetry.order() );
+   colors.reserve( _Vertices.size() * _Symmetry.order() );
+   sources.reserve( _Vertices.size() * _Symmetry.order() );
+   for ( const Vertex& a : _Vertices )
+   {
+      positions.push_back( a._Pos );
+      colors.push_back( a._Color );
+      sources.push_back( ImageSource{ a._Index, 0 } );
+   }
+   if ( _Symmetry.isTrivial() )
+      return;
+
+   std::vector<int> orbitSize;
+   orbitSize.reserve( _Vertices.size() );
+   for ( const Vertex& a : _Vertices )
+      orbitSize.push_back( _Symmetry.orbitSize( _Lattice, a._Pos ) );
+   for ( int k = 1; k < _Symmetry.order(); k++ )
+   {
+      for ( const Vertex& a : _Vertices )
+      {
+         if ( k >= orbitSize[a._Index] )
+            continue;
+         positions.push_back( normalizedPos( _Symmetry.rotation( k ) * a._Pos ) );
+         colors.push_back( _Symmetry.colorPerm( k )[a._Color] );
+         sources.push_back( ImageSource{ a._Index, k } );
+      }
+   }
+}
+
+void Simulation::images( PeriodicVertices& images, std::vector<ImageSource>* sources ) const
+{
+   std::vector<XYZ> positions;
+   std::vector<int> colors;
+   std::vector<ImageSource> ownSources;
+   collectImages( positions, colors, sources ? *sources : ownSources );
+   images._U = _U;
+   images._V = _V;
+   images._Vertices.resize( positions.size() );
+   for ( int i = 0; i < (int) positions.size(); i++ )
+      images._Vertices[i] = Vertex{ i, colors[i], positions[i] };
+}
+
+void Simulation::updateCellList()
+{
+   ScopedTimer timer( "cellList" );
+   std::vector<XYZ> positions;
+   std::vector<ImageSource> sources;
+   collectImages( positions, _ImageColors, sources );
+   int numColors = 0;
+   for ( int color : _ImageColors )
+      numColors = std::max( numColors, color + 1 );
+   _CellList.build( positions, _U, _V, maxMinDistance() );
+   _OrbitSize.assign( _Vertices.size(), 0 );
+   for ( const ImageSource& source : sources )
+      _OrbitSize[source._Vertex]++;
+
+   if ( !_PairDistances.empty() )
+   {
+      auto distance = [&]( int colorA, int colorB ) { return minDistance( colorA, colorB ); };
+      _DistanceTable.build( numColors, distance );
+      if ( _Kernel == SIMD_FLOAT )
+         _DistanceTableFloat.build( numColors, distance );
+   }
+}
+
+void Simulation::setNumThreads( int numThreads )
+{
+   if ( numThreads == 1 )
+      _ThreadPool.reset();
+   else
+      _ThreadPool.reset( new ThreadPool( numThreads ) );
+}
+
+XYZ Simulation::velocity( const VertexPtr& a, double scale, double& overlap2 ) const
+{
+   XYZ vel;
+   XYZ posA = _CellList.pos( a.rawIndex() );
+   int colorA = a.color();
+   // one loop per way of looking up the distance, so the common one stays as tight as before overrides existed
+   auto accumulate = [&]( auto minDistTo )
+   {
+      _CellList.forEachNeighbor( a.rawIndex(), [&]( int b, const XYZ& posB )
+      {
+         double minDist = minDistTo( _ImageColors[b] );
+
+         double dist2 = posA.dist2( posB );
+         if ( dist2 >= minDist*minDist )
+            return;
+         double dist = sqrt( dist2 );
+         double distError = minDist - dist;
+
+         vel += ( posA - posB ).normalized() * distError * scale;
+         overlap2 += distError * distError;
+      } );
+   };
+   if ( !_PairDistances.empty() )
+      accumulate( [&]( int colorB ) { return _DistanceTable( colorA, colorB ); } );
+   else
+      accumulate( [&]( int colorB ) { return colorA == colorB ? _MinDistanceAllowed_SameColor : _MinDistanceAllowed; } );
+   return vel;
+}
+
+template<typename Real>
+XYZ Simulation::velocity( const SoABuffer<Real>& soa, int i, double scale, double& overlap2 ) const
+{
+   const XYZ& posA = _CellList.pos( i );
+   int colorA = _Vertices[i]._Color;
+   Real sumX = 0;
+   Real sumY = 0;
+   Real sumOverlap2 = 0;
+   // the two-distance kernel unless some pair has its own distance
+   const Real* minDistRow = nullptr;
+   if ( !_PairDistances.empty() )
+   {
+      if constexpr ( std::is_same<Real, float>::value )
+         minDistRow = _DistanceTableFloat.row( colorA );
+      else
+         minDistRow = _DistanceTable.row( colorA );
+   }
+   _CellList.forEachNeighborCell( i, [&]( int begin, int end, const XYZ& offset )
+   {
+      // shift a by -offset instead of shifting every b by +offset
+      Real ax = (Real) ( posA.x - offset.x );
+      Real ay = (Real) ( posA.y - offset.y );
+      if ( minDistRow )
+         accumulateOverlap( ax, ay, minDistRow, soa, begin, end, sumX, sumY, sumOverlap2 );
+      else
+         accumulateOverlap( ax, ay, colorA, soa, begin, end, (Real) _MinDistanceAllowed, (Real) _MinDistanceAllowed_SameColor, sumX, sumY, sumOverlap2 );
+   } );
+   overlap2 = sumOverlap2;
+   return XYZ( sumX, sumY, 0 ) * scale;
+}
+
+void Simulation::velocities( double scale, std::vector<XYZ>& vel, std::vector<double>& overlap2 )
+{
+   constexpr int MIN_VERTICES_PER_TASK = 64;
+
+   vel.assign( _Vertices.size(), XYZ() );
+   overlap2.assign( _Vertices.size(), 0. );
+
+   updateCellList();
+
+   if ( _Kernel == SIMD_DOUBLE )
+      _SoA.build( _CellList, [&]( int i ) { return _ImageColors[i]; } );
+   if ( _Kernel == SIMD_FLOAT )
+      _SoAFloat.build( _CellList, [&]( int i ) { return _ImageColors[i]; } );
+
+   std::vector<VertexPtr> raw = rawVertices();
+   auto computeVelocities = [&]( int begin, int end )
+   {
+      for ( int i = begin; i < end; i++ )
+      {
+         switch ( _Kernel )
+         {
+         case SCALAR:      vel[i] = velocity( raw[i], scale, overlap2[i] ); break;
+         case SIMD_DOUBLE: vel[i] = velocity( _SoA, i, scale, overlap2[i] ); break;
+         case SIMD_FLOAT:  vel[i] = velocity( _SoAFloat, i, scale, overlap2[i] ); break;
+         }
+      }
+   };
+   {
+      ScopedTimer velocityTimer( "velocities" );
+      if ( _ThreadPool )
+         _ThreadPool->parallelFor( (int) raw.size(), MIN_VERTICES_PER_TASK, computeVelocities );
+      else
+         computeVelocities( 0, (int) raw.size() );
+   }
+   // a vertex on a rotation centre has to stay there; its surroundings are symmetric, so the forces cancel anyway
+   if ( !_Symmetry.isTrivial() )
+   {
+      for ( int i = 0; i < (int) vel.size(); i++ )
+         if ( _OrbitSize[i] < _Symmetry.order() )
+            vel[i] = XYZ();
+   }
+}
+
+double Simulation::energy( const std::vector<double>& overlap2 ) const
+{
+   double ret = 0;
+   // every pair shows up once from each side
+   if ( _Symmetry.isTrivial() )
+   {
+      for ( double x : overlap2 )
+         ret += .25 * x;
+      return ret;
+   }
+   // a vertex on a rotation centre is shared by fewer copies than the others
+   for ( int i = 0; i < (int) overlap2.size(); i++ )
+      ret += .25 * overlap2[i] * _OrbitSize[i] / _Symmetry.order();
+   return ret;
+}
+
+double Simulation::energy( std::vector<XYZ>& gradient )
+{
+   std::vector<double> overlap2;
+   velocities( -1, gradient, overlap2 );
+   double ret = energy( overlap2 );
+   if ( _ClickedVertex )
+      gradient[_ClickedVertex.rawIndex()] = XYZ();
+   return ret;
+}
+
+void Simulation::displace( const std::vector<XYZ>& delta, StepStats& stats )
+{
+   double sumMove2 = 0;
+   stats._MaxDisplacement = 0;
+   for ( const VertexPtr& a : rawVertices() )
+   {
+      if ( a._Vertex == _ClickedVertex._Vertex )
+         continue;
+      setPos( a, a.pos() + delta[a.rawIndex()] );
+      double move2 = delta[a.rawIndex()].len2();
+      sumMove2 += move2;
+      stats._MaxDisplacement = std::max( stats._MaxDisplacement, sqrt( move2 ) );
+   }
+   stats._RmsDisplacement = _Vertices.empty() ? 0 : sqrt( sumMove2 / _Vertices.size() );
+}
+
+StepStats Simulation::step()
+{
+   ScopedTimer timer( "step" );
+   if ( _Method != CLAMPED )
+   {
+      if ( !_Minimizer || _MinimizerMethod != _Method )
+      {
+         if ( _Method == FIRE )
+            _Minimizer.reset( new FireMinimizer );
+         else
+            _Minimizer.reset( new LbfgsMinimizer );
+         _MinimizerMethod = _Method;
+      }
+      return _Minimizer->step( *this );
+   }
+
+   constexpr double MAX_VEL = .1;
+   std::vector<XYZ> vel;
+   std::vector<double> overlap2;
+   velocities( _Tension, vel, overlap2 );
+
+   for ( XYZ& v : vel )
+   {
+      if ( v.len() > MAX_VEL )
+         v = v.normalized() * MAX_VEL;
+   }
+
+   StepStats stats;
+   stats._NumEvaluations = 1;
+   stats._Energy = energy( overlap2 );
+   displace( vel, stats );
+   return stats;
+}
+
+void Simulation::step( int numSteps )
+{
+   for ( int i = 0; i < numSteps; i++ )
+      step();
+}
+
+double Simulation::maxOverlap()
+{
+   updateCellList();
+   double ret = 0;
+   for ( const Vertex& a : _Vertices )
+   {
+      XYZ posA = _CellList.pos( a._Index );
+      _CellList.forEachNeighbor( a._Index, [&]( int b, const XYZ& posB )
+      {
+         double minDist = !_PairDistances.empty() ? _DistanceTable( a._Color, _ImageColors[b] )
+                        : a._Color == _ImageColors[b] ? _MinDistanceAllowed_SameColor : _MinDistanceAllowed;
+         ret = std::max( ret, minDist - posA.dist( posB ) );
+      } );
+   }
+   return ret;
+}
+
+void Simulation::addVertex( const XYZ& pos, int color )
+{
+   Vertex a { (int) _Vertices.size(), color, offCentrePos( pos, color ) };
+   _Vertices.push_back( a );
+}
+
+void Simulation::setColor( const VertexPtr& a, int color )
+{
+   Vertex* vertex = mutableOf( a._Vertex );
+   vertex->_Color = color;
+   vertex->_Pos = offCentrePos( vertex->_Pos, color );
+}
+
+XYZ Simulation::offCentrePos( const XYZ& pos, int color ) const
+{
+   if ( _Symmetry.keepsColor( _Lattice, pos, color ) )
+      return pos;
+   // far enough for the images to have a direction to push in, too little to come near another centre
+   double step = 1e-4 * std::min( _U.len(), _V.len() );
+   return normalizedPos( pos + XYZ( .6, .8, 0 ) * step );
+}
+
+void Simulation::moveOffCentres()
+{
+   for ( Vertex& a : _Vertices )
+      a._Pos = offCentrePos( a._Pos, a._Color );
+}
+
+void Simulation::deleteVertex( const VertexPtr& a )
+{
+   int index = a.rawIndex();
+   if ( index < 0 || index >= (int) _Vertices.size() )
+      return;
+
+   _Vertices.erase( _Vertices.begin() + index );
+
+   // renumber
+   for ( int i = index; i < (int) _Vertices.size(); i++ )
+      _Vertices[i]._Index = i;
+}
@@ -0,0 +1,225 @@
+#pragma once
+
+#include "DataTypes.h"
+#include "CellList.h"
+#include "PairKernel.h"
+#include "Symmetry.h"
+#include "ThreadPool.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class Vertex
+{
+public:
+   int _Index;
+   int _Color;
+   XYZ _Pos;
+};
+
+class Sector
+{
+public:
+   bool operator==( const Sector& rhs ) const { return x == rhs.x && y == rhs.y; }
+   Sector operator-() const { return {-x, -y}; }
+   Sector operator+( const Sector& rhs ) const { return { x + rhs.x, y + rhs.y }; }
+   Sector operator-( const Sector& rhs ) const { return { x - rhs.x, y - rhs.y }; }
+
+public:
+   int x, y;
+};
+
+class IGraphShape
+{
+public:
+   virtual XYZ pos( const XYZ& position, const Sector& sector ) const = 0;
+};
+
+class VertexPtr
+{
+public:
+   VertexPtr( const Vertex* vertex, const Sector& sector, const IGraphShape* graphShape )
+      : _Vertex( vertex ), _Sector( sector ), _GraphShape( graphShape )
+   {
+   }
+   VertexPtr() {}
+
+   bool operator==( const VertexPtr& rhs ) const { return _Vertex == rhs._Vertex && _Sector == rhs._Sector; }
+   operator bool() const { return !isNull(); }
+   bool isNull() const { return _Vertex == nullptr; }
+   int color() const { return _Vertex->_Color; }
+   XYZ pos() const { return _GraphShape->pos( _Vertex->_Pos, _Sector ); }
+   int rawIndex() const { return _Vertex->_Index; }
+
+public:
+   const IGraphShape* _GraphShape = nullptr;
+   const Vertex* _Vertex = nullptr;
+   Sector _Sector;
+};
+
+class StepStats
+{
+public:
+   double _MaxDisplacement = 0;
+   double _RmsDisplacement = 0;
+   // Simulation::energy() before the step moved anything
+   double _Energy = 0;
+   // force / energy evaluations the step needed
+   int _NumEvaluations = 0;
+};
+
+class IMinimizer;
+
+// where a vertex of the whole symmetric pattern comes from: element _Element of the group applied to _Vertex
+class ImageSource
+{
+public:
+   int _Vertex;
+   int _Element;
+};
+
+// vertices of the fundamental domain together with the lattice they repeat on
+class PeriodicVertices : public IGraphShape
+{
+public:
+   XYZ pos( const Sector& sector ) const { return _U * sector.x + _V * sector.y; }
+   XYZ pos( const XYZ& position, const Sector& sector ) const override { return position + pos( sector ); }
+   // sectors whose copy of the fundamental parallelogram comes within R of center, e.g. the ones a view shows
+   std::vector<Sector> sectorsInRange( const XYZ& center, double R ) const;
+   std::vector<VertexPtr> rawVertices() const;
+   VertexPtr rawVertex( int index ) const;
+   std::vector<VertexPtr> verticesInRange( double R ) const;
+
+public:
+   std::vector<Vertex> _Vertices;
+   XYZ _U;
+   XYZ _V;
+};
+
+// minimum distances of the colour pairs that don't use the two default distances
+class PairDistances
+{
+public:
+   class Entry
+   {
+   public:
+      int _ColorA;
+      int _ColorB;
+      double _MinDist;
+   };
+
+public:
+   bool empty() const { return _Entries.empty(); }
+   void clear() { _Entries.clear(); }
+   // the order of the colours doesn't matter
+   void set( int colorA, int colorB, double minDist );
+   void erase( int colorA, int colorB );
+   // false if the pair has no entry
+   bool find( int colorA, int colorB, double& minDist ) const;
+   double maxDistance() const;
+   // one entry per pair, _ColorA <= _ColorB, sorted
+   const std::vector<Entry>& entries() const { return _Entries; }
+
+   // "a-b:dist" items separated by spaces, e.g. "0-1:1.5 2-2:3"
+   std::string toString() const;
+   bool parse( const std::string& str, std::string& error );
+
+private:
+   std::vector<Entry> _Entries;
+};
+
+class Simulation : public PeriodicVertices
+{
+public:
+   // SCALAR is the reference loop; the SIMD kernels agree with it up to rounding (SIMD_FLOAT to float precision)
+   enum Kernel { SCALAR, SIMD_DOUBLE, SIMD_FLOAT };
+   // CLAMPED moves every vertex by its force times _Tension, at most .1 per step; FIRE and LBFGS minimise
+   // energy() directly and ignore _Tension
+   enum Method { CLAMPED, FIRE, LBFGS };
+
+public:
+   Simulation();
+   ~Simulation();
+
+   void setUV( const XYZ& u, const XYZ& v );
+   // setUV(), but fails if the new lattice lacks the symmetry's rotation
+   bool setUV( const XYZ& u, const XYZ& v, std::string& error );
+   // fails if the lattice lacks the symmetry's rotation
+   bool setSymmetry( const Symmetry& symmetry, std::string& error );
+   // 1 steps serially, 0 uses one thread per core
+   void setNumThreads( int numThreads );
+   int numThreads() const { return _ThreadPool ? _ThreadPool->numThreads() : 1; }
+
+   Vertex* mutableOf( const Vertex* vertex ) const { return const_cast<Vertex*>( vertex ); }
+   void setPos( const VertexPtr& a, const XYZ& pos ) { mutableOf( a._Vertex )->_Pos = normalizedPos( pos ); }
+   void setColor( const VertexPtr& a, int color );
+   Sector sectorAt( const XYZ& p ) const;
+   XYZ normalizedPos( const XYZ& p ) const { return _Lattice.wrap( p ); }
+   // pos, unless it is a rotation centre whose rotations would recolour a vertex of this colour: then a point
+   // slightly off it, from where the vertex's images push it away
+   XYZ offCentrePos( const XYZ& pos, int color ) const;
+   // offCentrePos() for every vertex; setUV(), setSymmetry(), setColor() and addVertex() keep to it
+   void moveOffCentres();
+   // _PairDistances if it has the pair, otherwise _MinDistanceAllowed_SameColor or _MinDistanceAllowed
+   double minDistance( int colorA, int colorB ) const;
+   // the interaction cutoff
+   double maxMinDistance() const;
+   // The whole pattern the stored vertices stand for under _Symmetry: all of them, then their images under
+   // element 1, 2, ... of the group. A vertex on a rotation centre has only the images that don't fall back onto it.
+   void collectImages( std::vector<XYZ>& positions, std::vector<int>& colors, std::vector<ImageSource>& sources ) const;
+   // collectImages() as vertices, for drawing and exporting; sources, if given, receives where each one comes from
+   void images( PeriodicVertices& images, std::vector<ImageSource>* sources = nullptr ) const;
+   // puts collectImages() into _CellList; also brings the distance tables up to date with _PairDistances
+   void updateCellList();
+   // a's pair force times scale; overlap2 receives the sum of (minDist - dist)^2 over a's overlapping neighbours
+   XYZ velocity( const VertexPtr& a, double scale, double& overlap2 ) const;
+   template<typename Real> XYZ velocity( const SoABuffer<Real>& soa, int i, double scale, double& overlap2 ) const;
+   // velocity() of every vertex, with _Kernel
+   void velocities( double scale, std::vector<XYZ>& vel, std::vector<double>& overlap2 );
+   // Sum over overlapping pairs of (minDist - dist)^2 / 2, which every Method descends; with a _Symmetry, that of
+   // one copy of the stored vertices among the group's. gradient receives its derivative by each vertex position,
+   // 0 for the clicked vertex and vertices on rotation centres.
+   double energy( std::vector<XYZ>& gradient );
+   // energy() from the overlap2 velocities() gave
+   double energy( const std::vector<double>& overlap2 ) const;
+   // moves every vertex but the clicked one by delta and fills in the displacements of stats
+   void displace( const std::vector<XYZ>& delta, StepStats& stats );
+   StepStats step();
+   void step( int numSteps );
+   // largest minDist - dist over all pairs, 0 when no pair is closer than allowed
+   double maxOverlap();
+   void addVertex( const XYZ& pos, int color );
+   void deleteVertex( const VertexPtr& a );
+
+public:
+   double _MinDistanceAllowed = .75;
+   double _MinDistanceAllowed_SameColor = 2.;
+   PairDistances _PairDistances;
+   // only the vertices of one copy under the group are stored and stepped, the others follow them
+   Symmetry _Symmetry;
+   // _U and _V with their inverse, kept by setUV()
+   Lattice2D _Lattice;
+   double _Tension = 0;
+   CellList _CellList;
+   std::unique_ptr<ThreadPool> _ThreadPool;
+   Kernel _Kernel = SIMD_DOUBLE;
+   Method _Method = CLAMPED;
+   // state of _Method across steps, for FIRE and LBFGS
+   std::unique_ptr<IMinimizer> _Minimizer;
+   Method _MinimizerMethod = CLAMPED;
+   SoABuffer<double> _SoA;
+   SoABuffer<float> _SoAFloat;
+   // minDistance() of every pair of colours present, only used while _PairDistances has entries
+   MinDistanceTable<double> _DistanceTable;
+   MinDistanceTable<float> _DistanceTableFloat;
+   // colour of every point in _CellList, the images' permuted by the symmetry
+   std::vector<int> _ImageColors;
+   // images per stored vertex in _CellList, _Symmetry.order() unless it sits on a rotation centre
+   std::vector<int> _OrbitSize;
+
+public:
+   VertexPtr _ClickedVertex;
+   // the group element of the image that was clicked, which follows the mouse in place of _ClickedVertex
+   int _ClickedElement = 0;
+};
@@ -0,0 +1,137 @@
+#include "SimulationRunner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+   // time spent stepping between two published snapshots
+   const std::chrono::milliseconds FRAME_BUDGET( 8 );
+}
+
+SimulationRunner::SimulationRunner( std::unique_ptr<Simulation> simulation )
+   : _Simulation( std::move( simulation ) )
+{
+   publish();
+   _Snapshots.read();
+   _Thread = std::thread( [this] { run(); } );
+}
+
+SimulationRunner::~SimulationRunner()
+{
+   {
+      std::lock_guard<std::mutex> lock( _Mutex );
+      _Quit = true;
+   }
+   _Wake.notify_one();
+   _Thread.join();
+}
+
+void SimulationRunner::post( Command command )
+{
+   post( PostedCommand { std::move( command ), true } );
+}
+
+void SimulationRunner::postQuery( Query query )
+{
+   post( PostedCommand { [query]( Simulation& simulation ) { query( simulation ); }, false } );
+}
+
+void SimulationRunner::post( PostedCommand command )
+{
+   {
+      std::lock_guard<std::mutex> lock( _Mutex );
+      _Commands.push_back( std::move( command ) );
+   }
+   _Wake.notify_one();
+}
+
+void SimulationRunner::setRunning( bool running )
+{
+   {
+      std::lock_guard<std::mutex> lock( _Mutex );
+      _Running = running;
+      _PublishRequested = true;
+   }
+   _Wake.notify_one();
+}
+
+void SimulationRunner::run()
+{
+   std::vector<PostedCommand> commands;
+
+   for ( ;; )
+   {
+      bool mustPublish;
+      {
+         std::unique_lock<std::mutex> lock( _Mutex );
+         _Wake.wait( lock, [this] { return _Quit || ( _Running && !_Scheduler.settled() ) || _PublishRequested || !_Commands.empty(); } );
+         if ( _Quit )
+            return;
+         commands.swap( _Commands );
+         mustPublish = _PublishRequested;
+         _PublishRequested = false;
+      }
+
+      bool modified = false;
+      for ( PostedCommand& command : commands )
+      {
+         command._Command( *_Simulation );
+         modified |= command._Modifies;
+      }
+      if ( modified )
+      {
+         _Scheduler.wakeUp();
+         mustPublish = true;
+      }
+      commands.clear();
+
+      bool stepping = _Running && !_Scheduler.settled();
+      if ( stepping )
+         _StepCount += _Scheduler.run( *_Simulation, FRAME_BUDGET );
+
+      if ( stepping || mustPublish )
+         publish();
+   }
+}
+
+void SimulationRunner::publish()
+{
+   SimulationSnapshot& snapshot = _Snapshots.writeBuffer();
+   _Simulation->images( snapshot, &snapshot._Sources );
+   snapshot._Symmetry = _Simulation->_Symmetry;
+   snapshot._StepCount = _StepCount;
+   snapshot._Stats = _Scheduler.lastStats();
+   snapshot._StepsPerSecond = _Scheduler.stepsPerSecond();
+   snapshot._Settled = _Scheduler.settled();
+   snapshot.updateIndex();
+   _Snapshots.publish();
+}
+
+void SimulationSnapshot::updateIndex()
+{
+   constexpr double POINTS_PER_CELL = 2;
+
+   std::vector<XYZ> positions;
+   positions.reserve( _Vertices.size() );
+   for ( const Vertex& a : _Vertices )
+      positions.push_back( a._Pos );
+   double area = fabs( _U.x * _V.y - _U.y * _V.x );
+   _Index.build( positions, _U, _V, sqrt( POINTS_PER_CELL * area / std::max<size_t>( 1, _Vertices.size() ) ) );
+}
+
+VertexPtr SimulationSnapshot::vertexAt( const XYZ& pos, double maxDist ) const
+{
+   VertexPtr ret;
+   double bestDist2 = maxDist * maxDist;
+   _Index.forEachInRange( pos, maxDist, [&]( int i, const XYZ& posI, int su, int sv )
+   {
+      double dist2 = posI.dist2( pos );
+      if ( dist2 >= bestDist2 )
+         return;
+      bestDist2 = dist2;
+      ret = VertexPtr( &_Vertices[i], Sector{ su, sv }, this );
+   } );
+   return ret;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Simulation.h"
+#include "StepScheduler.h"
+#include "TripleBuffer.h"
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// immutable copy of the simulation state for drawing and picking; the vertices are Simulation::images()
+class SimulationSnapshot : public PeriodicVertices
+{
+public:
+   // rebuilds _Index, after _Vertices or the lattice changed
+   void updateIndex();
+   // nearest image of any vertex within maxDist of pos, null if there is none
+   VertexPtr vertexAt( const XYZ& pos, double maxDist ) const;
+   // calls f( a ) for every image of every vertex within r of pos
+   template<typename F> void forEachVertexInRange( const XYZ& pos, double r, F f ) const
+   {
+      _Index.forEachInRange( pos, r, [&]( int i, const XYZ&, int su, int sv ) { f( VertexPtr( &_Vertices[i], Sector{ su, sv }, this ) ); } );
+   }
+
+public:
+   // the stored vertex and group element each vertex comes from
+   std::vector<ImageSource> _Sources;
+   Symmetry _Symmetry;
+   // a few vertices per cell, for picking
+   CellList _Index;
+   long long _StepCount = 0;
+   StepStats _Stats;
+   double _StepsPerSecond = 0;
+   bool _Settled = false;
+};
+
+// Steps a Simulation continuously on its own thread, in batches of about one frame, until it settles.
+// Any command wakes a settled simulation up again, queries don't.
+// Other threads only talk to it through post()ed commands and read back published snapshots.
+class SimulationRunner
+{
+public:
+   typedef std::function<void( Simulation& )> Command;
+   typedef std::function<void( const Simulation& )> Query;
+
+public:
+   explicit SimulationRunner( std::unique_ptr<Simulation> simulation );
+   ~SimulationRunner();
+
+   // runs command on the simulation thread between two steps, in the order posted
+   void post( Command command );
+   // like post(), for work that only reads the simulation, e.g. saving it
+   void postQuery( Query query );
+   void setRunning( bool running );
+   bool isRunning() const { return _Running; }
+
+   // newest published state; stays valid until the next call (single reader only)
+   const SimulationSnapshot& latestSnapshot() { return _Snapshots.read(); }
+   bool hasNewSnapshot() const { return _Snapshots.hasNew(); }
+
+private:
+   class PostedCommand
+   {
+   public:
+      Command _Command;
+      bool _Modifies;
+   };
+
+private:
+   void post( PostedCommand command );
+   void run();
+   void publish();
+
+private:
+   std::unique_ptr<Simulation> _Simulation;
+   long long _StepCount = 0;
+   StepScheduler _Scheduler;
+   TripleBuffer<SimulationSnapshot> _Snapshots;
+
+   std::mutex _Mutex;
+   std::condition_variable _Wake;
+   std::vector<PostedCommand> _Commands;
+   std::atomic<bool> _Running { false };
+   bool _PublishRequested = true;
+   bool _Quit = false;
+
+   std::thread _Thread;
+};
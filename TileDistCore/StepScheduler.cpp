@@ -0,0 +1,27 @@
+#include "StepScheduler.h"
+
+int StepScheduler::run( Simulation& simulation, Clock::duration budget, int maxSteps )
+{
+   Clock::time_point start = Clock::now();
+   bool unlimited = budget == Clock::duration::max();
+   Clock::time_point deadline = unlimited ? Clock::time_point::max() : start + budget;
+
+   int numSteps = 0;
+   while ( numSteps < maxSteps && !settled() )
+   {
+      _LastStats = simulation.step();
+      numSteps++;
+      _NumEvaluations += _LastStats._NumEvaluations;
+      if ( _LastStats._MaxDisplacement <= _Tolerance )
+         _QuietSteps++;
+      else
+         _QuietSteps = 0;
+      if ( Clock::now() >= deadline )
+         break;
+   }
+
+   double seconds = std::chrono::duration<double>( Clock::now() - start ).count();
+   if ( numSteps > 0 && seconds > 0 )
+      _StepsPerSecond = numSteps / seconds;
+   return numSteps;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Simulation.h"
+
+#include <chrono>
+#include <climits>
+
+// Runs as many Simulation::step() calls as fit into a time budget and notices when the vertices have settled.
+class StepScheduler
+{
+public:
+   typedef std::chrono::steady_clock Clock;
+
+public:
+   // steps until budget has elapsed, maxSteps steps are done or the simulation has settled; returns the number of steps
+   int run( Simulation& simulation, Clock::duration budget, int maxSteps = INT_MAX );
+
+   // no vertex moved more than _Tolerance during the last _SettleSteps steps
+   bool settled() const { return _QuietSteps >= _SettleSteps; }
+   // call after edits so that a settled simulation gets going again
+   void wakeUp() { _QuietSteps = 0; }
+
+   const StepStats& lastStats() const { return _LastStats; }
+   double stepsPerSecond() const { return _StepsPerSecond; }
+   // StepStats::_NumEvaluations summed over every run()
+   long long numEvaluations() const { return _NumEvaluations; }
+
+public:
+   double _Tolerance = 1e-6;
+   int _SettleSteps = 20;
+
+private:
+   int _QuietSteps = 0;
+   StepStats _LastStats;
+   double _StepsPerSecond = 0;
+   long long _NumEvaluations = 0;
+};
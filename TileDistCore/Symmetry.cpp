@@ -0,0 +1,115 @@
+#include "Symmetry.h"
+
+#include <sstream>
+
+namespace
+{
+   // lattice coordinates closer than this to whole numbers count as the same point
+   const double SAME_POINT_TOLERANCE = 1e-9;
+   // rotations must map u and v this close to lattice vectors
+   const double FIT_TOLERANCE = 1e-6;
+
+   // cos and sin of multiples of 90 and 60 degrees, which PI's few digits only get to within 1e-12 or so
+   double snap( double x )
+   {
+      for ( double exact : { -1., -sqrt( .75 ), -.5, 0., .5, sqrt( .75 ), 1. } )
+         if ( fabs( x - exact ) < 1e-9 )
+            return exact;
+      return x;
+   }
+
+   bool isLatticeVector( const Lattice2D& lattice, const XYZ& d, double tolerance )
+   {
+      XYZ ab = lattice.toLattice( d );
+      return fabs( ab.x - round( ab.x ) ) <= tolerance && fabs( ab.y - round( ab.y ) ) <= tolerance;
+   }
+}
+
+Symmetry::Symmetry( int order, const Perm& colorPerm )
+   : _ColorPerm( colorPerm )
+{
+   for ( int k = 0; k < order; k++ )
+   {
+      double angle = 2 * PI * k / order;
+      double c = snap( cos( angle ) );
+      double s = snap( sin( angle ) );
+      _Rotations.push_back( Affine2D( c, -s, s, c, 0, 0 ) );
+      _ColorPerms.push_back( colorPerm.pow( k ) );
+   }
+}
+
+bool Symmetry::fits( const Lattice2D& lattice ) const
+{
+   if ( isTrivial() )
+      return true;
+   return isLatticeVector( lattice, rotation( 1 ).linear( lattice.u() ), FIT_TOLERANCE )
+       && isLatticeVector( lattice, rotation( 1 ).linear( lattice.v() ), FIT_TOLERANCE );
+}
+
+int Symmetry::orbitSize( const Lattice2D& lattice, const XYZ& p ) const
+{
+   // the elements fixing p form a subgroup, generated by the first of them
+   for ( int k = 1; k < order(); k++ )
+      if ( order() % k == 0 && isLatticeVector( lattice, rotation( k ) * p - p, SAME_POINT_TOLERANCE ) )
+         return k;
+   return order();
+}
+
+bool Symmetry::keepsColor( const Lattice2D& lattice, const XYZ& p, int color ) const
+{
+   // element orbitSize() generates the ones fixing p, it is the identity when there are none
+   return colorPerm( orbitSize( lattice, p ) % order() )[color] == color;
+}
+
+std::string Symmetry::toString() const
+{
+   std::string ret = "p" + std::to_string( order() );
+   for ( int c : _ColorPerm.v )
+      ret += " " + std::to_string( c );
+   return ret;
+}
+
+bool Symmetry::parse( const std::string& str, std::string& error )
+{
+   std::istringstream ss( str );
+   std::string group;
+   ss >> group;
+   int order = group.size() == 2 && group[0] == 'p' ? group[1] - '0' : 0;
+   Perm colorPerm;
+   int c;
+   while ( ss >> c )
+      colorPerm.v.push_back( c );
+   if ( !ss.eof() )
+   {
+      error = "bad colour permutation in '" + str + "'";
+      return false;
+   }
+   return set( order, colorPerm, error );
+}
+
+bool Symmetry::set( int order, const Perm& colorPerm, std::string& error )
+{
+   if ( order != 1 && order != 2 && order != 3 && order != 4 && order != 6 )
+   {
+      error = "bad symmetry, expected p1, p2, p3, p4 or p6";
+      return false;
+   }
+   std::vector<bool> seen( colorPerm.v.size() );
+   for ( int c : colorPerm.v )
+   {
+      if ( c < 0 || c >= (int) colorPerm.v.size() || seen[c] )
+      {
+         error = "the colour permutation must hold each of 0 .. " + std::to_string( (int) colorPerm.v.size() - 1 ) + " once";
+         return false;
+      }
+      seen[c] = true;
+   }
+   // a full turn is the identity, so it has to give every colour back
+   if ( !colorPerm.pow( order ).isIdentity() )
+   {
+      error = "applying the colour permutation " + std::to_string( order ) + " times must give the colours back";
+      return false;
+   }
+   *this = Symmetry( order, colorPerm );
+   return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "DataTypes.h"
+
+#include <string>
+#include <vector>
+
+// Rotational wallpaper group pN with colours: the pattern looks the same after a rotation about the origin by
+// 360/N degrees that also recolours colour c as colorPerm()[c]. N is 1, 2, 3, 4 or 6, the only rotations a
+// lattice can have; p1 is no symmetry beyond the lattice's translations.
+class Symmetry
+{
+public:
+   Symmetry() : Symmetry( 1, Perm() ) {}
+   Symmetry( int order, const Perm& colorPerm );
+
+   bool operator==( const Symmetry& rhs ) const { return order() == rhs.order() && _ColorPerm == rhs._ColorPerm; }
+   bool operator!=( const Symmetry& rhs ) const { return !( *this == rhs ); }
+
+   int order() const { return (int) _Rotations.size(); }
+   bool isTrivial() const { return order() == 1; }
+   const Perm& colorPerm() const { return _ColorPerm; }
+   // element k, 0 <= k < order(), rotates by k * 360/N degrees and recolours with colorPerm() to the k
+   const Affine2D& rotation( int k ) const { return _Rotations[k]; }
+   const Perm& colorPerm( int k ) const { return _ColorPerms[k]; }
+
+   // the rotation maps the lattice onto itself
+   bool fits( const Lattice2D& lattice ) const;
+   // number of distinct images of p, up to the lattice: order() unless p sits on a rotation centre, where the
+   // first images are p again
+   int orbitSize( const Lattice2D& lattice, const XYZ& p ) const;
+   // the rotations that leave p where it is leave colour as it is, too; when they don't, a vertex at p would
+   // have to have two colours at once
+   bool keepsColor( const Lattice2D& lattice, const XYZ& p, int color ) const;
+
+   // "p3", or with a colour permutation "p3 1 2 0"
+   std::string toString() const;
+   bool parse( const std::string& str, std::string& error );
+   // fails unless order is one of the above and colorPerm a permutation of 0 .. n-1 that order turns give back
+   bool set( int order, const Perm& colorPerm, std::string& error );
+
+private:
+   Perm _ColorPerm;
+   std::vector<Affine2D> _Rotations;
+   std::vector<Perm> _ColorPerms;
+};
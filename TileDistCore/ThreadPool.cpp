@@ -0,0 +1,82 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool( int numThreads )
+{
+   if ( numThreads <= 0 )
+      numThreads = std::max( 1, (int) std::thread::hardware_concurrency() );
+   for ( int i = 1; i < numThreads; i++ )
+      _Threads.emplace_back( [this] { workerLoop(); } );
+}
+
+ThreadPool::~ThreadPool()
+{
+   {
+      std::lock_guard<std::mutex> lock( _Mutex );
+      _Quit = true;
+   }
+   _WorkReady.notify_all();
+   for ( std::thread& t : _Threads )
+      t.join();
+}
+
+void ThreadPool::parallelFor( int n, int minChunkSize, const std::function<void( int, int )>& f )
+{
+   if ( _Threads.empty() || n <= minChunkSize )
+   {
+      if ( n > 0 )
+         f( 0, n );
+      return;
+   }
+
+   {
+      std::lock_guard<std::mutex> lock( _Mutex );
+      _Job = &f;
+      _JobSize = n;
+      // a few chunks per thread so uneven chunks even out
+      _ChunkSize = std::max( minChunkSize, ( n + 4 * numThreads() - 1 ) / ( 4 * numThreads() ) );
+      _NextChunk = 0;
+      _BusyWorkers = (int) _Threads.size();
+      _Generation++;
+   }
+   _WorkReady.notify_all();
+
+   runChunks();
+
+   std::unique_lock<std::mutex> lock( _Mutex );
+   _WorkDone.wait( lock, [this] { return _BusyWorkers == 0; } );
+   _Job = nullptr;
+}
+
+void ThreadPool::runChunks()
+{
+   for ( ;; )
+   {
+      int begin = _NextChunk.fetch_add( _ChunkSize );
+      if ( begin >= _JobSize )
+         return;
+      (*_Job)( begin, std::min( _JobSize, begin + _ChunkSize ) );
+   }
+}
+
+void ThreadPool::workerLoop()
+{
+   int seenGeneration = 0;
+   for ( ;; )
+   {
+      {
+         std::unique_lock<std::mutex> lock( _Mutex );
+         _WorkReady.wait( lock, [&] { return _Quit || _Generation != seenGeneration; } );
+         if ( _Quit )
+            return;
+         seenGeneration = _Generation;
+      }
+
+      runChunks();
+
+      std::lock_guard<std::mutex> lock( _Mutex );
+      if ( --_BusyWorkers == 0 )
+         _WorkDone.notify_one();
+   }
+}
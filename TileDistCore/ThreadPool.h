@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that stay alive between jobs.
+class ThreadPool
+{
+public:
+   // numThreads counts the calling thread, which also works on each job; 0 means one per core
+   explicit ThreadPool( int numThreads );
+   ~ThreadPool();
+   ThreadPool( const ThreadPool& ) = delete;
+   ThreadPool& operator=( const ThreadPool& ) = delete;
+
+   int numThreads() const { return (int) _Threads.size() + 1; }
+
+   // calls f( begin, end ) on disjoint chunks covering [0, n) and returns once all of them are done.
+   // Ranges of at most minChunkSize items run inline on the calling thread.
+   void parallelFor( int n, int minChunkSize, const std::function<void( int, int )>& f );
+
+private:
+   void workerLoop();
+   void runChunks();
+
+private:
+   std::vector<std::thread> _Threads;
+   std::mutex _Mutex;
+   std::condition_variable _WorkReady;
+   std::condition_variable _WorkDone;
+   bool _Quit = false;
+   int _Generation = 0;
+   int _BusyWorkers = 0;
+
+   const std::function<void( int, int )>* _Job = nullptr;
+   int _JobSize = 0;
+   int _ChunkSize = 1;
+   std::atomic<int> _NextChunk { 0 };
+};
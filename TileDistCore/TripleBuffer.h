@@ -0,0 +1,33 @@
+#pragma once
+
+#include <atomic>
+
+// Lock-free hand-over of the newest value from one writer thread to one reader thread.
+// The writer fills writeBuffer() and publish()es it; the reader picks up the newest published
+// value with read(). Neither side ever waits for the other, and slots are reused so their contents
+// keep their allocations.
+template<typename T>
+class TripleBuffer
+{
+public:
+   T& writeBuffer() { return _Slots[_Back]; }
+   void publish() { _Back = _Middle.exchange( _Back | NEW ) & INDEX; }
+
+   bool hasNew() const { return ( _Middle.load() & NEW ) != 0; }
+   // stays valid until the next call to read()
+   const T& read()
+   {
+      if ( hasNew() )
+         _Front = _Middle.exchange( _Front ) & INDEX;
+      return _Slots[_Front];
+   }
+
+private:
+   static const int INDEX = 3;
+   static const int NEW = 4;
+
+   T _Slots[3];
+   int _Front = 0;
+   int _Back = 1;
+   std::atomic<int> _Middle { 2 };
+};
@@ -0,0 +1,524 @@
+#include "Simulation.h"
+#include "Checkpoint.h"
+#include "Delauney.h"
+#include "DualImport.h"
+#include "PairKernel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+// Checks of engine behaviour that is easy to get subtly wrong. Each case prints what failed; the exit code is the
+// number of failed cases.
+namespace
+{
+   int s_NumFailures = 0;
+
+   void check( bool ok, const char* what, int line )
+   {
+      if ( ok )
+         return;
+      printf( "   failed at line %d: %s\n", line, what );
+      s_NumFailures++;
+   }
+
+#define CHECK( condition ) check( (condition), #condition, __LINE__ )
+
+   const XYZ HEX_U( 6, 0, 0 );
+   const XYZ HEX_V( 3, 6 * sqrt( .75 ), 0 );
+
+   Symmetry parsedSymmetry( const std::string& spec )
+   {
+      Symmetry symmetry;
+      std::string error;
+      if ( !symmetry.parse( spec, error ) )
+         printf( "   %s\n", error.c_str() );
+      return symmetry;
+   }
+
+   // distance of a and b when points a lattice vector apart are the same
+   double periodicDistance( const Lattice2D& lattice, const XYZ& a, const XYZ& b )
+   {
+      XYZ ab = lattice.toLattice( a - b );
+      ab.x -= round( ab.x );
+      ab.y -= round( ab.y );
+      return lattice.toCartesian( ab ).len();
+   }
+
+   // the images a vertex contributes to the whole pattern
+   int numImagesOf( const Simulation& simulation, int index )
+   {
+      PeriodicVertices images;
+      std::vector<ImageSource> sources;
+      simulation.images( images, &sources );
+      int n = 0;
+      for ( const ImageSource& source : sources )
+         n += source._Vertex == index;
+      return n;
+   }
+
+   void symmetryCentres()
+   {
+      class Centre
+      {
+      public:
+         XYZ _Pos;
+         // rotations about _Pos in p6 are by multiples of 360 / _Order degrees
+         int _Order;
+         // a permutation whose power for those rotations recolours colour 0
+         const char* _Recolouring;
+      };
+      for ( const Centre& centre : { Centre { XYZ( 0, 0, 0 ), 6, "p6 1 0" }, Centre { ( HEX_U + HEX_V ) / 3, 3, "p6 1 2 0" }, Centre { HEX_U / 2, 2, "p6 1 0" } } )
+      {
+         // a vertex there would need two colours at once, so it is moved off and has all 6 images
+         Simulation simulation;
+         simulation.setUV( HEX_U, HEX_V );
+         std::string error;
+         CHECK( simulation.setSymmetry( parsedSymmetry( centre._Recolouring ), error ) );
+         simulation.addVertex( centre._Pos, 0 );
+         XYZ pos = simulation._Vertices[0]._Pos;
+         CHECK( ( pos - centre._Pos ).len() > 0 );
+         CHECK( simulation._Symmetry.keepsColor( simulation._Lattice, pos, 0 ) );
+         CHECK( numImagesOf( simulation, 0 ) == 6 );
+
+         // without a colour permutation it stays and has 6 / _Order images
+         Simulation plain;
+         plain.setUV( HEX_U, HEX_V );
+         CHECK( plain.setSymmetry( parsedSymmetry( "p6" ), error ) );
+         plain.addVertex( centre._Pos, 0 );
+         CHECK( ( plain._Vertices[0]._Pos - centre._Pos ).len() == 0 );
+         CHECK( numImagesOf( plain, 0 ) == 6 / centre._Order );
+
+         // switching to the permutation moves it off
+         plain.setColor( plain.rawVertex( 0 ), 1 );
+         CHECK( ( plain._Vertices[0]._Pos - centre._Pos ).len() == 0 );
+         CHECK( plain.setSymmetry( parsedSymmetry( centre._Recolouring ), error ) );
+         CHECK( ( plain._Vertices[0]._Pos - centre._Pos ).len() > 0 );
+         CHECK( numImagesOf( plain, 0 ) == 6 );
+      }
+
+      // 120 degree turns of "p6 1 0" swap the colours twice, so a vertex may stay on a 3-fold centre
+      Simulation threeFold;
+      threeFold.setUV( HEX_U, HEX_V );
+      std::string error;
+      CHECK( threeFold.setSymmetry( parsedSymmetry( "p6 1 0" ), error ) );
+      threeFold.addVertex( ( HEX_U + HEX_V ) / 3, 0 );
+      CHECK( ( threeFold._Vertices[0]._Pos - ( HEX_U + HEX_V ) / 3 ).len() == 0 );
+      CHECK( numImagesOf( threeFold, 0 ) == 2 );
+
+      // the images of a vertex pushed off the centre move apart
+      Simulation simulation;
+      simulation.setUV( HEX_U, HEX_V );
+      simulation._Tension = .05;
+      CHECK( simulation.setSymmetry( parsedSymmetry( "p6 1 0" ), error ) );
+      simulation.addVertex( XYZ( 0, 0, 0 ), 0 );
+      for ( int i = 0; i < 200; i++ )
+         simulation.step();
+      CHECK( simulation.maxOverlap() < 1e-3 );
+   }
+
+   // stepping the stored vertices of a symmetric pattern must move its images as stepping all of them would
+   void symmetryMatchesFullPattern()
+   {
+      for ( const char* spec : { "p2 1 0", "p3 1 2 0", "p4 1 0", "p6 1 2 0", "p6" } )
+      {
+         Simulation symmetric;
+         symmetric.setNumThreads( 1 );
+         symmetric._Tension = .05;
+         symmetric._MinDistanceAllowed = 1.1;
+         symmetric._MinDistanceAllowed_SameColor = 1.6;
+         Symmetry symmetry = parsedSymmetry( spec );
+         if ( symmetry.order() == 4 )
+            symmetric.setUV( XYZ( 6, 0, 0 ), XYZ( 0, 6, 0 ) );
+         else
+            symmetric.setUV( HEX_U, HEX_V );
+         std::string error;
+         CHECK( symmetric.setSymmetry( symmetry, error ) );
+         std::mt19937_64 rng( 5 );
+         std::uniform_real_distribution<double> uniform( 0, 1 );
+         for ( int i = 0; i < 30; i++ )
+            symmetric.addVertex( symmetric._U * uniform( rng ) + symmetric._V * uniform( rng ), i % 2 );
+         // on the centre, where colour 0 has to change for "p2 1 0" and the like
+         symmetric.addVertex( XYZ( 0, 0, 0 ), 0 );
+
+         Simulation full;
+         full.setNumThreads( 1 );
+         full._Tension = symmetric._Tension;
+         full._MinDistanceAllowed = symmetric._MinDistanceAllowed;
+         full._MinDistanceAllowed_SameColor = symmetric._MinDistanceAllowed_SameColor;
+         full.setUV( symmetric._U, symmetric._V );
+         PeriodicVertices images;
+         symmetric.images( images );
+         for ( const Vertex& a : images._Vertices )
+            full.addVertex( a._Pos, a._Color );
+         // a vertex left on the centre doesn't move in the symmetric simulation, so it mustn't in the full one
+         if ( numImagesOf( symmetric, 30 ) < symmetry.order() )
+            full._ClickedVertex = full.rawVertex( 30 );
+
+         for ( int step = 0; step < 100; step++ )
+         {
+            StepStats a = symmetric.step();
+            StepStats b = full.step();
+            if ( step == 99 )
+               CHECK( fabs( a._Energy * symmetry.order() - b._Energy ) <= 1e-9 * ( 1 + b._Energy ) );
+         }
+         symmetric.images( images );
+         double maxDiff = 0;
+         for ( int i = 0; i < (int) images._Vertices.size(); i++ )
+            maxDiff = std::max( maxDiff, periodicDistance( full._Lattice, images._Vertices[i]._Pos, full._Vertices[i]._Pos ) );
+         CHECK( maxDiff < 1e-6 );
+      }
+   }
+
+   // Corners of a periodic Delaunay triangulation: counter-clockwise, with no image of any vertex strictly inside the
+   // circumcircle, and 2n triangles tiling one cell
+   void checkPeriodicDelauney( const XYZ& u, const XYZ& v, int numVertices, unsigned seed )
+   {
+      PeriodicVertices vertices;
+      vertices._U = u;
+      vertices._V = v;
+      std::mt19937_64 rng( seed );
+      std::uniform_real_distribution<double> uniform( 0, 1 );
+      for ( int i = 0; i < numVertices; i++ )
+         vertices._Vertices.push_back( Vertex { i, 0, u * uniform( rng ) + v * uniform( rng ) } );
+
+      std::vector<PeriodicTriangle> triangles = periodicDelauney( vertices );
+      CHECK( (int) triangles.size() == 2 * numVertices );
+      Lattice2D lattice( u, v );
+      double gradA = v.len() / fabs( u.x * v.y - u.y * v.x );
+      double gradB = u.len() / fabs( u.x * v.y - u.y * v.x );
+      double area = 0;
+      int numBad = 0;
+      for ( const PeriodicTriangle& tri : triangles )
+      {
+         XYZ p[3];
+         for ( int k = 0; k < 3; k++ )
+            p[k] = vertices.pos( vertices._Vertices[tri._Index[k]]._Pos, tri._Sector[k] );
+         double twiceArea = ( p[1].x - p[0].x ) * ( p[2].y - p[0].y ) - ( p[1].y - p[0].y ) * ( p[2].x - p[0].x );
+         numBad += !( twiceArea > 0 );
+         area += twiceArea / 2;
+
+         XYZ b = p[1] - p[0];
+         XYZ c = p[2] - p[0];
+         double d = 2 * ( b.x * c.y - b.y * c.x );
+         XYZ center = p[0] + XYZ( c.y * b.len2() - b.y * c.len2(), b.x * c.len2() - c.x * b.len2(), 0 ) / d;
+         double radius = center.dist( p[0] );
+         // every sector whose images of some vertex could reach into the circle
+         XYZ ab = lattice.toLattice( center );
+         int minA = (int) floor( ab.x - radius * gradA ) - 1, maxA = (int) ceil( ab.x + radius * gradA ) + 1;
+         int minB = (int) floor( ab.y - radius * gradB ) - 1, maxB = (int) ceil( ab.y + radius * gradB ) + 1;
+         // no Delaunay circle is wider than the cell's covering radius, which these cells are far below
+         if ( radius > u.len() + v.len() )
+         {
+            numBad++;
+            continue;
+         }
+         for ( const Vertex& a : vertices._Vertices )
+            for ( int sy = minB; sy <= maxB; sy++ )
+               for ( int sx = minA; sx <= maxA; sx++ )
+                  numBad += vertices.pos( a._Pos, Sector { sx, sy } ).dist( center ) < radius * ( 1 - 1e-9 );
+      }
+      CHECK( numBad == 0 );
+      CHECK( fabs( area - fabs( u.x * v.y - u.y * v.x ) ) < 1e-9 * fabs( u.x * v.y - u.y * v.x ) * numVertices );
+   }
+
+   // cells so skewed or sparse that a margin of a couple of cells around the fundamental domain misses images
+   void periodicDelauneyIsExact()
+   {
+      checkPeriodicDelauney( HEX_U, HEX_V, 200, 1 );
+      checkPeriodicDelauney( HEX_U, HEX_V, 1, 2 );
+      checkPeriodicDelauney( XYZ( 1, 0, 0 ), XYZ( 0, 1, 0 ), 2, 3 );
+      checkPeriodicDelauney( XYZ( 1, 0, 0 ), XYZ( 37.2, .05, 0 ), 1, 4 );
+      checkPeriodicDelauney( XYZ( 1, 0, 0 ), XYZ( 37.2, .05, 0 ), 5, 5 );
+      checkPeriodicDelauney( XYZ( 1, 0, 0 ), XYZ( 0.3, 20, 0 ), 3, 6 );
+      checkPeriodicDelauney( XYZ( 20, 0, 0 ), XYZ( 19.7, 1, 0 ), 40, 7 );
+   }
+
+   // every point of the disc lies in one of the returned sectors, each of which is returned once
+   void checkSectorsInRange( const XYZ& u, const XYZ& v, const XYZ& center, double R, unsigned seed )
+   {
+      PeriodicVertices vertices;
+      vertices._U = u;
+      vertices._V = v;
+      std::vector<Sector> sectors = vertices.sectorsInRange( center, R );
+      for ( int i = 0; i < (int) sectors.size(); i++ )
+         for ( int j = 0; j < i; j++ )
+            CHECK( !( sectors[i] == sectors[j] ) );
+
+      Lattice2D lattice( u, v );
+      std::mt19937_64 rng( seed );
+      std::uniform_real_distribution<double> uniform( 0, 1 );
+      int numMissed = 0;
+      for ( int i = 0; i < 20000; i++ )
+      {
+         // the boundary circle too, where the disc reaches furthest
+         double angle = 2 * PI * uniform( rng );
+         double r = i % 2 ? R : R * sqrt( uniform( rng ) );
+         XYZ p = lattice.toLattice( center + XYZ( cos( angle ), sin( angle ), 0 ) * r );
+         Sector sector { (int) floor( p.x ), (int) floor( p.y ) };
+         numMissed += std::find( sectors.begin(), sectors.end(), sector ) == sectors.end();
+      }
+      CHECK( numMissed == 0 );
+   }
+
+   void sectorsCoverView()
+   {
+      checkSectorsInRange( HEX_U, HEX_V, ( HEX_U + HEX_V ) * .5, 9.4, 1 );
+      checkSectorsInRange( HEX_U, HEX_V, XYZ( -17.3, 4.1, 0 ), .5, 2 );
+      checkSectorsInRange( XYZ( 1, 0, 0 ), XYZ( 37.2, .05, 0 ), XYZ( 3, 1, 0 ), 6, 3 );
+      checkSectorsInRange( XYZ( 1, 0, 0 ), XYZ( 0.3, 20, 0 ), XYZ( 0, 0, 0 ), 25, 4 );
+      checkSectorsInRange( XYZ( 20, 0, 0 ), XYZ( 19.7, 1, 0 ), XYZ( 10, -3, 0 ), 4, 5 );
+      PeriodicVertices parallel;
+      parallel._U = XYZ( 1, 0, 0 );
+      parallel._V = XYZ( 2, 0, 0 );
+      CHECK( parallel.sectorsInRange( XYZ( 0, 0, 0 ), 1 ).empty() );
+   }
+
+   bool importDualText( const std::string& text, DualGraph& graph, std::string& error )
+   {
+      const char* filename = "TileDistTests.dual";
+      FILE* f = fopen( filename, "wb" );
+      if ( !f )
+      {
+         error = "cannot create the test file";
+         return false;
+      }
+      fwrite( text.data(), 1, text.size(), f );
+      fclose( f );
+      bool ok = importDual( filename, graph, error );
+      remove( filename );
+      return ok;
+   }
+
+   // integers may be written as 1e+05, but anything that isn't one in int range is an error
+   void dualImportIntegers()
+   {
+      auto withNeighbor = []( const std::string& index )
+      {
+         return "{\"vertices\":[{\"color\":0,\"index\":0,\"neighbors\":[{\"index\":" + index + ",\"sector\":0}],\"pos\":[0,0,0]}]}";
+      };
+      DualGraph graph;
+      std::string error;
+      CHECK( importDualText( withNeighbor( "0" ), graph, error ) );
+      CHECK( importDualText( withNeighbor( "0e+00" ), graph, error ) );
+      for ( const char* bad : { "1.5", "1e12", "-1e12", "99999999999", "nan", "inf" } )
+      {
+         CHECK( !importDualText( withNeighbor( bad ), graph, error ) );
+         CHECK( error.find( "expected an integer" ) != std::string::npos || error.find( "expected a number" ) != std::string::npos );
+      }
+   }
+
+   std::string readFile( const char* filename )
+   {
+      std::string bytes;
+      FILE* f = fopen( filename, "rb" );
+      if ( !f )
+         return bytes;
+      char buffer[4096];
+      size_t n;
+      while ( ( n = fread( buffer, 1, sizeof( buffer ), f ) ) > 0 )
+         bytes.append( buffer, n );
+      fclose( f );
+      return bytes;
+   }
+
+   void writeFile( const char* filename, const std::string& bytes )
+   {
+      FILE* f = fopen( filename, "wb" );
+      if ( !f )
+         return;
+      fwrite( bytes.data(), 1, bytes.size(), f );
+      fclose( f );
+   }
+
+   // a checkpoint loads back exactly as saved; damaged files and ones from newer versions are refused and leave the
+   // simulation alone
+   void checkpointRoundTrip()
+   {
+      const char* filename = "TileDistTests.tdck";
+      Simulation saved;
+      saved.setUV( HEX_U, HEX_V );
+      std::string error;
+      CHECK( saved.setSymmetry( parsedSymmetry( "p3 1 2 0" ), error ) );
+      std::mt19937_64 rng( 8 );
+      std::uniform_real_distribution<double> uniform( 0, 1 );
+      for ( int i = 0; i < 50; i++ )
+         saved.addVertex( HEX_U * uniform( rng ) + HEX_V * uniform( rng ), i % 3 );
+      saved._MinDistanceAllowed = .8;
+      saved._MinDistanceAllowed_SameColor = 1.7;
+      saved._PairDistances.set( 0, 2, 1.25 );
+      saved._Tension = .05;
+      CHECK( saveCheckpoint( saved, filename, error ) );
+
+      Simulation loaded;
+      CHECK( loadCheckpoint( filename, loaded, error ) );
+      CHECK( loaded._U == saved._U && loaded._V == saved._V );
+      CHECK( loaded._Symmetry.toString() == saved._Symmetry.toString() );
+      CHECK( loaded._MinDistanceAllowed == saved._MinDistanceAllowed );
+      CHECK( loaded._MinDistanceAllowed_SameColor == saved._MinDistanceAllowed_SameColor );
+      CHECK( loaded._PairDistances.toString() == saved._PairDistances.toString() );
+      CHECK( loaded._Tension == saved._Tension );
+      CHECK( loaded._Vertices.size() == saved._Vertices.size() );
+      for ( int i = 0; i < (int) std::min( loaded._Vertices.size(), saved._Vertices.size() ); i++ )
+      {
+         CHECK( loaded._Vertices[i]._Pos == saved._Vertices[i]._Pos );
+         CHECK( loaded._Vertices[i]._Color == saved._Vertices[i]._Color );
+      }
+
+      std::string bytes = readFile( filename );
+      for ( size_t size : { (size_t) 0, (size_t) 40, bytes.size() / 2, bytes.size() - 1 } )
+      {
+         writeFile( filename, bytes.substr( 0, size ) );
+         Simulation untouched;
+         CHECK( !loadCheckpoint( filename, untouched, error ) );
+         CHECK( untouched._Vertices.empty() );
+      }
+      // the version follows the four magic bytes
+      std::string newer = bytes;
+      newer[4]++;
+      writeFile( filename, newer );
+      Simulation untouched;
+      CHECK( !loadCheckpoint( filename, untouched, error ) );
+      CHECK( error.find( "newer version" ) != std::string::npos );
+      CHECK( untouched._Vertices.empty() );
+      remove( filename );
+   }
+
+   // a lattice change the symmetry doesn't survive is refused, and a state where it happened anyway isn't saved
+   void latticeKeepsSymmetry()
+   {
+      const char* filename = "TileDistTests.tdck";
+      remove( filename );
+      Simulation simulation;
+      simulation.setUV( HEX_U, HEX_V );
+      std::string error;
+      CHECK( simulation.setSymmetry( parsedSymmetry( "p3" ), error ) );
+      simulation.addVertex( ( HEX_U + HEX_V ) * .3, 0 );
+      CHECK( simulation.setUV( HEX_U * 2, HEX_V * 2, error ) );
+      CHECK( !simulation.setUV( XYZ( 13, 0, 0 ), HEX_V * 2, error ) );
+      CHECK( simulation._U == HEX_U * 2 && simulation._Symmetry.fits( simulation._Lattice ) );
+
+      simulation.setUV( XYZ( 13, 0, 0 ), HEX_V * 2 );
+      CHECK( !saveCheckpoint( simulation, filename, error ) );
+      CHECK( readFile( filename ).empty() );
+      remove( filename );
+   }
+
+   // velocities() from every image of every vertex closer than its pair's minimum distance, one pair at a time
+   void bruteForceVelocities( const Simulation& simulation, double scale, std::vector<XYZ>& vel, std::vector<double>& overlap2 )
+   {
+      vel.assign( simulation._Vertices.size(), XYZ() );
+      overlap2.assign( simulation._Vertices.size(), 0. );
+      double det = fabs( simulation._U.x * simulation._V.y - simulation._U.y * simulation._V.x );
+      double height = std::min( det / simulation._U.len(), det / simulation._V.len() );
+      int range = (int) ceil( simulation.maxMinDistance() / height ) + 1;
+      for ( const Vertex& a : simulation._Vertices )
+      {
+         for ( const Vertex& b : simulation._Vertices )
+         {
+            double minDist = simulation.minDistance( a._Color, b._Color );
+            for ( int y = -range; y <= range; y++ )
+            {
+               for ( int x = -range; x <= range; x++ )
+               {
+                  if ( &a == &b && x == 0 && y == 0 )
+                     continue;
+                  XYZ ab = a._Pos - simulation.pos( b._Pos, Sector { x, y } );
+                  double dist = ab.len();
+                  if ( dist >= minDist )
+                     continue;
+                  vel[a._Index] += ab.normalized() * ( minDist - dist ) * scale;
+                  overlap2[a._Index] += ( minDist - dist ) * ( minDist - dist );
+               }
+            }
+         }
+      }
+   }
+
+   // every kernel agrees with the brute force sum, up to float precision for SIMD_FLOAT, with the two default
+   // distances and with a distance table
+   void kernelsMatchBruteForce()
+   {
+      printf( "   pair kernels compiled for %s\n", pairKernelInstructionSet() );
+      for ( bool pairDistances : { false, true } )
+      {
+         for ( Simulation::Kernel kernel : { Simulation::SCALAR, Simulation::SIMD_DOUBLE, Simulation::SIMD_FLOAT } )
+         {
+            Simulation simulation;
+            simulation.setUV( HEX_U * 1.5, HEX_V * 1.5 );
+            simulation._Kernel = kernel;
+            simulation._Tension = .05;
+            if ( pairDistances )
+            {
+               simulation._PairDistances.set( 0, 1, 1.3 );
+               simulation._PairDistances.set( 2, 2, 2.6 );
+               simulation._PairDistances.set( 0, 0, .5 );
+            }
+            std::mt19937_64 rng( 4 );
+            std::uniform_real_distribution<double> uniform( 0, 1 );
+            // more than the SIMD width of vertices per cell of the cell list, so the vector loops and the tails both run
+            for ( int i = 0; i < 300; i++ )
+               simulation.addVertex( simulation._U * uniform( rng ) + simulation._V * uniform( rng ), i % 3 );
+
+            double tolerance = kernel == Simulation::SIMD_FLOAT ? 1e-4 : 1e-9;
+            double maxVelError = 0;
+            double maxOverlapError = 0;
+            for ( int step = 0; step < 10; step++ )
+            {
+               std::vector<XYZ> vel, expectedVel;
+               std::vector<double> overlap2, expectedOverlap2;
+               simulation.velocities( 1, vel, overlap2 );
+               bruteForceVelocities( simulation, 1, expectedVel, expectedOverlap2 );
+               for ( int i = 0; i < (int) vel.size(); i++ )
+               {
+                  maxVelError = std::max( maxVelError, ( vel[i] - expectedVel[i] ).len() / ( 1 + expectedVel[i].len() ) );
+                  maxOverlapError = std::max( maxOverlapError, fabs( overlap2[i] - expectedOverlap2[i] ) / ( 1 + expectedOverlap2[i] ) );
+               }
+               simulation.step();
+            }
+            CHECK( maxVelError < tolerance );
+            CHECK( maxOverlapError < tolerance );
+         }
+      }
+   }
+
+   class Case
+   {
+   public:
+      const char* _Name;
+      std::function<void()> _Run;
+   };
+}
+
+int main( int argc, char* argv[] )
+{
+   const Case cases[] = {
+      { "symmetryCentres", symmetryCentres },
+      { "symmetryMatchesFullPattern", symmetryMatchesFullPattern },
+      { "periodicDelauneyIsExact", periodicDelauneyIsExact },
+      { "dualImportIntegers", dualImportIntegers },
+      { "sectorsCoverView", sectorsCoverView },
+      { "checkpointRoundTrip", checkpointRoundTrip },
+      { "latticeKeepsSymmetry", latticeKeepsSymmetry },
+      { "kernelsMatchBruteForce", kernelsMatchBruteForce },
+   };
+
+   int numFailedCases = 0;
+   for ( const Case& c : cases )
+   {
+      // an argument runs only the cases whose name contains it
+      if ( argc > 1 && !strstr( c._Name, argv[1] ) )
+         continue;
+      int failuresBefore = s_NumFailures;
+      c._Run();
+      bool ok = s_NumFailures == failuresBefore;
+      printf( "%-32s %s\n", c._Name, ok ? "ok" : "FAILED" );
+      numFailedCases += !ok;
+   }
+   return numFailedCases;
+}